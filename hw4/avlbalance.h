@@ -0,0 +1,181 @@
+#ifndef AVLBALANCE_H
+#define AVLBALANCE_H
+
+#include <cstdint>
+
+/**
+* The AVL rotations and rebalancing shared by AVLTree, whose nodes link to each other by
+* pointer, and CompactAVLTree, whose nodes link by index into one vector. Access says how
+* to follow and change the links of a node reference of type Access::NodeRef:
+*
+*   NodeRef nil() const                         the null reference
+*   NodeRef left(n), right(n), parent(n)
+*   void setLeft(n, c), setRight(n, c), setParent(n, c)    c may be nil()
+*   int8_t balance(n), void setBalance(n, b)    height(right) - height(left)
+*   void replaceChild(p, old, n)                points p's link to old at n, or the root
+*                                               when p is nil()
+*   void rotated(down, up)                      called once up has taken down's place, so
+*                                               that data kept per subtree can follow
+*/
+template <typename Access>
+class AVLBalance
+{
+public:
+    typedef typename Access::NodeRef NodeRef;
+
+    static void rotateLeft(Access& a, NodeRef n);
+    static void rotateRight(Access& a, NodeRef n);
+    static void insertFix(Access& a, NodeRef p, NodeRef n);
+    static void removeFix(Access& a, NodeRef n, int8_t diff);
+};
+
+/*
+ * A rotation moves n down to the side named and its child on the other
+ * side up into its place.
+ */
+template<class Access>
+void AVLBalance<Access>::rotateLeft(Access& a, NodeRef n)
+{
+    NodeRef r = a.right(n);
+    NodeRef p = a.parent(n);
+    NodeRef rl = a.left(r);
+    a.setRight(n, rl);
+    if(rl != a.nil()) {
+        a.setParent(rl, n);
+    }
+    a.setLeft(r, n);
+    a.setParent(n, r);
+    a.setParent(r, p);
+    a.rotated(n, r);
+    a.replaceChild(p, n, r);
+}
+
+template<class Access>
+void AVLBalance<Access>::rotateRight(Access& a, NodeRef n)
+{
+    NodeRef l = a.left(n);
+    NodeRef p = a.parent(n);
+    NodeRef lr = a.right(l);
+    a.setLeft(n, lr);
+    if(lr != a.nil()) {
+        a.setParent(lr, n);
+    }
+    a.setRight(l, n);
+    a.setParent(n, l);
+    a.setParent(l, p);
+    a.rotated(n, l);
+    a.replaceChild(p, n, l);
+}
+
+/*
+ * The subtree at p, parent of n, just grew by one.  Walks up while the
+ * growth propagates; stops at the first node whose height is unchanged,
+ * or after the one rotation that restores the height it had before.
+ */
+template<class Access>
+void AVLBalance<Access>::insertFix(Access& a, NodeRef p, NodeRef n)
+{
+    NodeRef g = a.parent(p);
+    while(g != a.nil()) {
+        int8_t side = (p == a.left(g)) ? -1 : 1;
+        a.setBalance(g, a.balance(g) + side);
+        if(a.balance(g) == 0) {
+            return;
+        }
+        if(a.balance(g) == side) {
+            n = p;
+            p = g;
+            g = a.parent(g);
+            continue;
+        }
+        // g is out of balance towards p's side
+        if(a.balance(p) == side) {
+            // zig-zig
+            if(side < 0) rotateRight(a, g);
+            else rotateLeft(a, g);
+            a.setBalance(p, 0);
+            a.setBalance(g, 0);
+        }
+        else {
+            // zig-zag: n ends up on top
+            if(side < 0) {
+                rotateLeft(a, p);
+                rotateRight(a, g);
+            }
+            else {
+                rotateRight(a, p);
+                rotateLeft(a, g);
+            }
+            int8_t b = a.balance(n);
+            a.setBalance(p, b == -side ? side : 0);
+            a.setBalance(g, b == side ? -side : 0);
+            a.setBalance(n, 0);
+        }
+        return;
+    }
+}
+
+/*
+ * The subtree on one side of n just shrank by one, which changes n's
+ * balance by diff.  Walks up while n's height keeps dropping; stops at
+ * the first node whose height is unchanged, including after a rotation
+ * about a child with zero balance.
+ */
+template<class Access>
+void AVLBalance<Access>::removeFix(Access& a, NodeRef n, int8_t diff)
+{
+    while(n != a.nil() && diff != 0) {
+        NodeRef p = a.parent(n);
+        int8_t nextDiff = 0;
+        if(p != a.nil()) {
+            nextDiff = (n == a.left(p)) ? 1 : -1;
+        }
+        int8_t b = a.balance(n) + diff;
+        if(b == 0) {
+            // was leaning towards the shrunk side; now one shorter
+            a.setBalance(n, 0);
+        }
+        else if(b == diff) {
+            // was even; height unchanged
+            a.setBalance(n, b);
+            return;
+        }
+        else {
+            // b == 2 * diff: rotate the taller child c up
+            NodeRef c = (diff < 0) ? a.left(n) : a.right(n);
+            int8_t cb = a.balance(c);
+            if(cb == 0) {
+                if(diff < 0) rotateRight(a, n);
+                else rotateLeft(a, n);
+                a.setBalance(n, diff);
+                a.setBalance(c, -diff);
+                return;
+            }
+            if(cb == diff) {
+                if(diff < 0) rotateRight(a, n);
+                else rotateLeft(a, n);
+                a.setBalance(n, 0);
+                a.setBalance(c, 0);
+            }
+            else {
+                NodeRef g = (diff < 0) ? a.right(c) : a.left(c);
+                if(diff < 0) {
+                    rotateLeft(a, c);
+                    rotateRight(a, n);
+                }
+                else {
+                    rotateRight(a, c);
+                    rotateLeft(a, n);
+                }
+                int8_t gb = a.balance(g);
+                a.setBalance(n, gb == diff ? -diff : 0);
+                a.setBalance(c, gb == -diff ? diff : 0);
+                a.setBalance(g, 0);
+            }
+        }
+        n = p;
+        diff = nextDiff;
+    }
+}
+
+#endif
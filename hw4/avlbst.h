@@ -6,14 +6,27 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include "bst.h"
+#include "avlbalance.h"
+#include "nodearena.h"
+#include "frozentree.h"
 
 struct KeyError { };
 
 /**
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
-* other additional helper functions. You do NOT need to implement any functionality or
-* add additional data members or helper functions.
+* other additional helper functions. Nodes are allocated from their tree's NodeArena
+* rather than the heap, so the class replaces operator new and delete. Each node also
+* carries the size of its subtree, which only an OrderStatisticsTree keeps up to date.
 */
 template <typename Key, typename Value>
 class AVLNode : public Node<Key, Value>
@@ -28,6 +41,10 @@ public:
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
+    // Getter/setter for the number of nodes in the subtree, kept by OrderStatisticsTree only.
+    uint32_t getSize() const { return size_; }
+    void setSize(uint32_t size) { size_ = size; }
+
     // Getters for parent, left, and right. These need to be redefined since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
@@ -35,8 +52,16 @@ public:
     virtual AVLNode<Key, Value>* getLeft() const override;
     virtual AVLNode<Key, Value>* getRight() const override;
 
+    // Nodes live in their AVLTree's NodeArena and are built there with placement new.
+    // delete (as in BinarySearchTree::clear()) runs the destructor only and leaves the
+    // memory to the arena; a plain new AVLNode does not compile.
+    static void* operator new(size_t, void* where) { return where; }
+    static void operator delete(void*, void*) { }
+    static void operator delete(void*) { }
+
 protected:
     int8_t balance_;    // effectively a signed char
+    uint32_t size_;     // fits in the padding after balance_
 };
 
 /*
@@ -51,7 +76,7 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent), balance_(0), size_(1)
 {
 
 }
@@ -128,48 +153,930 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
+template <class Key, class Value, bool Counted = false>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
-    virtual void remove(const Key& key);  // TODO
+    AVLTree();
+    virtual ~AVLTree();
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    // Removes every node. Their memory goes back in whole slabs, and when Key and
+    // Value need no destructor the nodes are not even visited.
+    void clear();
+
+    /**
+    * Replaces the contents with the pairs in [first, last), whose keys must be strictly
+    * increasing, as a perfectly balanced tree in O(n).
+    * Throws std::invalid_argument (leaving the tree unchanged) if they are not.
+    */
+    template<typename ForwardIt>
+    void buildFromSorted(ForwardIt first, ForwardIt last);
+
+    /**
+    * Moves every item whose key is not less than key into right, replacing its contents,
+    * in O(log n). The two trees then share node memory (see below).
+    */
+    void split(const Key& key, AVLTree& right);
+
+    /**
+    * Appends every item of right, all of whose keys must be greater than those here,
+    * in O(log n), and empties right. Throws std::invalid_argument if they are not.
+    * No node is copied; if the trees do not share memory yet, it also takes one step
+    * per slab (of up to 64K nodes) to merge their arenas.
+    */
+    void join(AVLTree& right);
+
+    /**
+    * Set operations that consume other, leaving it empty, in O(m log(n/m + 1)) for trees
+    * of m <= n items. Items whose key is in both trees keep the value from this tree.
+    * With threads other than 1 (0 for every hardware thread) the recursion forks its
+    * large halves onto other threads.
+    */
+    void unionWith(AVLTree& other, unsigned threads = 1);
+    void intersectWith(AVLTree& other, unsigned threads = 1);
+    void subtract(AVLTree& other, unsigned threads = 1);
+
+    // A tree that is split, or joined or combined with another, moves its nodes into one
+    // arena shared by every such tree, so that nodes can pass between trees without being
+    // copied. That arena locks on each allocation and free, so trees using it may be
+    // modified from different threads at once; it is freed when the last of them is.
+
+    /**
+    * Order statistics, for trees with Counted set (see OrderStatisticsTree), which keep
+    * the size of every subtree in its root. Each is O(log n).
+    */
+    // Number of items
+    size_t size() const;
+    // Number of keys less than key
+    size_t rank(const Key& key) const;
+    // The item with k keys before it, or end() if k >= size()
+    typename BinarySearchTree<Key, Value>::iterator select(size_t k) const;
+    // Number of keys in [lo, hi)
+    size_t countRange(const Key& lo, const Key& hi) const;
+    // The item a fraction p of the way through the keys by the nearest-rank method
+    // (0.5 gives the lower median), or end() if the tree is empty.
+    // Throws std::invalid_argument if p is outside [0, 1].
+    typename BinarySearchTree<Key, Value>::iterator percentile(double p) const;
+
+    /**
+    * Copies the items into a read-only FrozenTree, whose lookups avoid chasing a pointer
+    * per level, in O(n). The second form reuses snapshot's storage, for refreezing after
+    * a batch of updates.
+    */
+    FrozenTree<Key, Value> freeze() const;
+    void freeze(FrozenTree<Key, Value>& snapshot) const;
+
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
+    AVLNode<Key,Value>* createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent);
+    void destroyNode(AVLNode<Key,Value>* n);
+
     // Add helper functions here
 
+    // The tree's links as AVLBalance follows them
+    struct NodeAccess {
+        typedef AVLNode<Key,Value>* NodeRef;
+        AVLTree* tree;
+        NodeRef nil() const { return NULL; }
+        NodeRef left(NodeRef n) const { return n->getLeft(); }
+        NodeRef right(NodeRef n) const { return n->getRight(); }
+        NodeRef parent(NodeRef n) const { return n->getParent(); }
+        void setLeft(NodeRef n, NodeRef c) const { n->setLeft(c); }
+        void setRight(NodeRef n, NodeRef c) const { n->setRight(c); }
+        void setParent(NodeRef n, NodeRef c) const { n->setParent(c); }
+        int8_t balance(NodeRef n) const { return n->getBalance(); }
+        void setBalance(NodeRef n, int8_t b) const { n->setBalance(b); }
+        void replaceChild(NodeRef p, NodeRef old, NodeRef n) const;
+        void rotated(NodeRef down, NodeRef up) const
+        {
+            up->setSize(down->getSize());
+            resize(down);
+        }
+    };
+    typedef AVLBalance<NodeAccess> Balance;
+    static uint32_t sizeOf(AVLNode<Key,Value>* n) { return (n == NULL) ? 0 : n->getSize(); }
+    // Recomputes n's subtree size from its children when Counted
+    static void resize(AVLNode<Key,Value>* n);
+    // Adds diff to the size of n and every ancestor when Counted
+    static void addToSizes(AVLNode<Key,Value>* n, int diff);
+    // Throws std::length_error when Counted and n more items would overflow the sizes
+    void checkRoom(size_t n) const;
+
+    // A subtree with its height, for the join-based bulk operations. Heights of children
+    // follow from a node's balance, so they are never stored.
+    struct Subtree {
+        AVLNode<Key,Value>* root;
+        int height;
+    };
+    // Smallest subtree height at which the set operations fork
+    static const int PARALLEL_MIN_HEIGHT = 12;
+
+    static int height(AVLNode<Key,Value>* n);
+    static void expose(const Subtree& t, Subtree& left, Subtree& right);
+    static Subtree makeNode(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right);
+    static Subtree rebalance(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right);
+    static Subtree joinRight(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right);
+    static Subtree joinLeft(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right);
+    static Subtree join(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right);
+    static Subtree join2(const Subtree& left, const Subtree& right);
+    static Subtree splitLast(const Subtree& t, AVLNode<Key,Value>*& last);
+    static void splitAt(const Subtree& t, const Key& key, Subtree& left, AVLNode<Key,Value>*& mid, Subtree& right);
+    // The set operations; nodes they drop go to garbage, to be destroyed by the caller
+    static Subtree unionOf(const Subtree& a, const Subtree& b, std::vector<AVLNode<Key,Value>*>& garbage, int forks);
+    static Subtree intersectionOf(const Subtree& a, const Subtree& b, std::vector<AVLNode<Key,Value>*>& garbage, int forks);
+    static Subtree differenceOf(const Subtree& a, const Subtree& b, std::vector<AVLNode<Key,Value>*>& garbage, int forks);
+    static void discard(AVLNode<Key,Value>* n, std::vector<AVLNode<Key,Value>*>& garbage);
+    template<typename L, typename R>
+    static void forkJoin(bool fork, L left, R right);
+    static int forkDepth(unsigned threads);
+
+    template<typename ForwardIt>
+    Subtree buildSubtree(ForwardIt& it, size_t n);
+    void setRoot(const Subtree& t);
+    Subtree whole() const;
+    // The iterator at n; its constructor from a node is only open to derived classes
+    struct NodeIterator : public BinarySearchTree<Key, Value>::iterator {
+        explicit NodeIterator(Node<Key, Value>* n) : BinarySearchTree<Key, Value>::iterator(n) {}
+    };
+    // Makes this tree and other allocate from the shared arena, moving no node
+    void takeNodes(AVLTree& other);
+    // Moves this tree's slabs into the shared arena unless they are already there
+    void shareArena();
+    // The shared arena, made anew if no tree holds it
+    static std::shared_ptr<NodeArena<AVLNode<Key,Value> > > sharedArena();
+    typedef Subtree (*SetOp)(const Subtree&, const Subtree&, std::vector<AVLNode<Key,Value>*>&, int);
+    void setOperation(AVLTree& other, unsigned threads, SetOp op);
+
+    std::shared_ptr<NodeArena<AVLNode<Key,Value> > > arena_;  // every node of the tree
 
 };
 
+template<class Key, class Value, bool Counted>
+AVLTree<Key, Value, Counted>::AVLTree() :
+    arena_(std::make_shared<NodeArena<AVLNode<Key, Value> > >())
+{
+
+}
+
+/*
+ * Clears before the arena goes, so the base destructor finds nothing left to delete.
+ */
+template<class Key, class Value, bool Counted>
+AVLTree<Key, Value, Counted>::~AVLTree()
+{
+    clear();
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::clear()
+{
+    if(arena_->locking()) {
+        // other trees' nodes share the arena: hand back ours one by one instead
+        std::vector<AVLNode<Key, Value>*> nodes;
+        discard(static_cast<AVLNode<Key, Value>*>(this->root_), nodes);
+        for(AVLNode<Key, Value>* n : nodes) {
+            destroyNode(n);
+        }
+        this->root_ = NULL;
+        arena_ = std::make_shared<NodeArena<AVLNode<Key, Value> > >();
+        return;
+    }
+    if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value) {
+        BinarySearchTree<Key, Value>::clear();
+    }
+    this->root_ = NULL;
+    arena_->release();
+}
+
+template<class Key, class Value, bool Counted>
+AVLNode<Key, Value>* AVLTree<Key, Value, Counted>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    void* where = arena_->allocate();
+    try {
+        return new (where) AVLNode<Key, Value>(key, value, parent);
+    }
+    catch(...) {
+        arena_->deallocate(where);
+        throw;
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::destroyNode(AVLNode<Key, Value>* n)
+{
+    n->~AVLNode();
+    arena_->deallocate(n);
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::insert (const std::pair<const Key, Value> &new_item)
 {
-    // TODO
+    const Key& key = new_item.first;
+    if(this->root_ == NULL) {
+        this->root_ = createNode(key, new_item.second, NULL);
+        return;
+    }
+    AVLNode<Key, Value>* p = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* n;
+    checkRoom(1);
+    while(true) {
+        if(key < p->getKey()) {
+            if(p->getLeft() == NULL) {
+                n = createNode(key, new_item.second, p);
+                p->setLeft(n);
+                break;
+            }
+            p = p->getLeft();
+        }
+        else if(p->getKey() < key) {
+            if(p->getRight() == NULL) {
+                n = createNode(key, new_item.second, p);
+                p->setRight(n);
+                break;
+            }
+            p = p->getRight();
+        }
+        else {
+            p->setValue(new_item.second);
+            return;
+        }
+    }
+    addToSizes(p, 1);
+    // p had one child before, so its height is unchanged
+    if(p->getBalance() != 0) {
+        p->setBalance(0);
+        return;
+    }
+    p->updateBalance(n == p->getLeft() ? -1 : 1);
+    NodeAccess a = { this };
+    Balance::insertFix(a, p, n);
 }
 
 /*
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>:: remove(const Key& key)
 {
-    // TODO
+    AVLNode<Key, Value>* n = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    if(n == NULL) {
+        return;
+    }
+    if(n->getLeft() != NULL && n->getRight() != NULL) {
+        nodeSwap(n, static_cast<AVLNode<Key, Value>*>(this->predecessor(n)));
+    }
+    AVLNode<Key, Value>* c = (n->getLeft() != NULL) ? n->getLeft() : n->getRight();
+    AVLNode<Key, Value>* p = n->getParent();
+    int8_t diff = 0;
+    if(c != NULL) {
+        c->setParent(p);
+    }
+    if(p == NULL) {
+        this->root_ = c;
+    }
+    else if(p->getLeft() == n) {
+        p->setLeft(c);
+        diff = 1;
+    }
+    else {
+        p->setRight(c);
+        diff = -1;
+    }
+    destroyNode(n);
+    addToSizes(p, -1);
+    NodeAccess a = { this };
+    Balance::removeFix(a, p, diff);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::NodeAccess::replaceChild(NodeRef p, NodeRef old, NodeRef n) const
+{
+    if(p == NULL) {
+        tree->root_ = n;
+    }
+    else if(p->getLeft() == old) {
+        p->setLeft(n);
+    }
+    else {
+        p->setRight(n);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
     BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+    uint32_t tempS = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempS);
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::resize(AVLNode<Key,Value>* n)
+{
+    if(Counted) {
+        n->setSize(sizeOf(n->getLeft()) + sizeOf(n->getRight()) + 1);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::addToSizes(AVLNode<Key,Value>* n, int diff)
+{
+    if(Counted) {
+        for(; n != NULL; n = n->getParent()) {
+            n->setSize(n->getSize() + diff);
+        }
+    }
 }
 
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::checkRoom(size_t n) const
+{
+    if(Counted && n > UINT32_MAX - sizeOf(static_cast<AVLNode<Key,Value>*>(this->root_))) {
+        throw std::length_error("AVLTree: too many items to count");
+    }
+}
+
+/*
+ * Bulk operations, after Blelloch, Ferizovic and Sun, "Just Join for Parallel Ordered
+ * Sets": everything is built from join(), which links two trees and a middle node in
+ * time proportional to the difference of their heights.
+ */
+
+template<class Key, class Value, bool Counted>
+int AVLTree<Key, Value, Counted>::height(AVLNode<Key,Value>* n)
+{
+    int h = 0;
+    while(n != NULL) {
+        h++;
+        n = (n->getBalance() < 0) ? n->getLeft() : n->getRight();
+    }
+    return h;
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::expose(const Subtree& t, Subtree& left, Subtree& right)
+{
+    int8_t b = t.root->getBalance();
+    left.root = t.root->getLeft();
+    left.height = t.height - (b > 0 ? 2 : 1);
+    right.root = t.root->getRight();
+    right.height = t.height - (b < 0 ? 2 : 1);
+}
+
+/*
+ * Links k above left and right, whose heights differ by at most one.
+ */
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::makeNode(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right)
+{
+    k->setParent(NULL);
+    k->setLeft(left.root);
+    k->setRight(right.root);
+    if(left.root != NULL) {
+        left.root->setParent(k);
+    }
+    if(right.root != NULL) {
+        right.root->setParent(k);
+    }
+    k->setBalance(right.height - left.height);
+    resize(k);
+    Subtree t = { k, std::max(left.height, right.height) + 1 };
+    return t;
+}
+
+/*
+ * As makeNode(), for heights that differ by up to two, rotating once or twice.
+ */
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::rebalance(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right)
+{
+    Subtree a, b, c, d;
+    if(right.height > left.height + 1) {
+        expose(right, a, b);
+        if(b.height >= a.height) {
+            return makeNode(makeNode(left, k, a), right.root, b);
+        }
+        expose(a, c, d);
+        return makeNode(makeNode(left, k, c), a.root, makeNode(d, right.root, b));
+    }
+    if(left.height > right.height + 1) {
+        expose(left, a, b);
+        if(a.height >= b.height) {
+            return makeNode(a, left.root, makeNode(b, k, right));
+        }
+        expose(b, c, d);
+        return makeNode(makeNode(a, left.root, c), b.root, makeNode(d, k, right));
+    }
+    return makeNode(left, k, right);
+}
+
+/*
+ * Joins down the right spine of left, which is more than one taller than right.
+ */
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::joinRight(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right)
+{
+    Subtree ll, lr;
+    expose(left, ll, lr);
+    Subtree t = (lr.height <= right.height + 1) ? makeNode(lr, k, right) : joinRight(lr, k, right);
+    return rebalance(ll, left.root, t);
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::joinLeft(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right)
+{
+    Subtree rl, rr;
+    expose(right, rl, rr);
+    Subtree t = (rl.height <= left.height + 1) ? makeNode(left, k, rl) : joinLeft(left, k, rl);
+    return rebalance(t, right.root, rr);
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::join(const Subtree& left, AVLNode<Key,Value>* k, const Subtree& right)
+{
+    if(left.height > right.height + 1) {
+        return joinRight(left, k, right);
+    }
+    if(right.height > left.height + 1) {
+        return joinLeft(left, k, right);
+    }
+    return makeNode(left, k, right);
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::splitLast(const Subtree& t, AVLNode<Key,Value>*& last)
+{
+    Subtree l, r;
+    expose(t, l, r);
+    if(r.root == NULL) {
+        last = t.root;
+        return l;
+    }
+    Subtree rest = splitLast(r, last);
+    return join(l, t.root, rest);
+}
+
+/*
+ * Joins two trees without a middle node, borrowing the last node of left.
+ */
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::join2(const Subtree& left, const Subtree& right)
+{
+    if(left.root == NULL) {
+        return right;
+    }
+    AVLNode<Key,Value>* last;
+    Subtree rest = splitLast(left, last);
+    return join(rest, last, right);
+}
+
+/*
+ * Splits t into the keys less than key, the node with key (or NULL), and the rest.
+ */
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::splitAt(const Subtree& t, const Key& key, Subtree& left,
+                                  AVLNode<Key,Value>*& mid, Subtree& right)
+{
+    if(t.root == NULL) {
+        left = right = t;
+        mid = NULL;
+        return;
+    }
+    Subtree l, r, part;
+    expose(t, l, r);
+    if(key < t.root->getKey()) {
+        splitAt(l, key, left, mid, part);
+        right = join(part, t.root, r);
+    }
+    else if(t.root->getKey() < key) {
+        splitAt(r, key, part, mid, right);
+        left = join(l, t.root, part);
+    }
+    else {
+        left = l;
+        mid = t.root;
+        right = r;
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::discard(AVLNode<Key,Value>* n, std::vector<AVLNode<Key,Value>*>& garbage)
+{
+    if(n != NULL) {
+        discard(n->getLeft(), garbage);
+        discard(n->getRight(), garbage);
+        garbage.push_back(n);
+    }
+}
+
+/*
+ * Runs left() and right(), left() on another thread if fork and one can be started.
+ */
+template<class Key, class Value, bool Counted>
+template<typename L, typename R>
+void AVLTree<Key, Value, Counted>::forkJoin(bool fork, L left, R right)
+{
+    std::future<void> f;
+    if(fork) {
+        try {
+            f = std::async(std::launch::async, left);
+        }
+        catch(const std::system_error&) {
+            fork = false;
+        }
+    }
+    right();
+    if(fork) {
+        f.get();
+    }
+    else {
+        left();
+    }
+}
+
+template<class Key, class Value, bool Counted>
+int AVLTree<Key, Value, Counted>::forkDepth(unsigned threads)
+{
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int depth = 0;
+    while((1u << depth) < threads) {
+        depth++;
+    }
+    return depth;
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::unionOf(const Subtree& a, const Subtree& b, std::vector<AVLNode<Key,Value>*>& garbage, int forks)
+{
+    if(a.root == NULL) {
+        return b;
+    }
+    if(b.root == NULL) {
+        return a;
+    }
+    Subtree bl, br, al, ar, l, r;
+    expose(b, bl, br);
+    AVLNode<Key,Value>* k = b.root;
+    AVLNode<Key,Value>* m;
+    splitAt(a, k->getKey(), al, m, ar);
+    if(m != NULL) {
+        garbage.push_back(k);
+        k = m;
+    }
+    std::vector<AVLNode<Key,Value>*> leftGarbage;
+    bool fork = forks > 0 && std::min(a.height, b.height) >= PARALLEL_MIN_HEIGHT;
+    forkJoin(fork,
+        [&]() { l = unionOf(al, bl, leftGarbage, forks - 1); },
+        [&]() { r = unionOf(ar, br, garbage, forks - 1); });
+    garbage.insert(garbage.end(), leftGarbage.begin(), leftGarbage.end());
+    return join(l, k, r);
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::intersectionOf(const Subtree& a, const Subtree& b, std::vector<AVLNode<Key,Value>*>& garbage, int forks)
+{
+    if(a.root == NULL || b.root == NULL) {
+        discard(a.root, garbage);
+        discard(b.root, garbage);
+        Subtree empty = { NULL, 0 };
+        return empty;
+    }
+    Subtree bl, br, al, ar, l, r;
+    expose(b, bl, br);
+    AVLNode<Key,Value>* m;
+    splitAt(a, b.root->getKey(), al, m, ar);
+    garbage.push_back(b.root);
+    std::vector<AVLNode<Key,Value>*> leftGarbage;
+    bool fork = forks > 0 && std::min(a.height, b.height) >= PARALLEL_MIN_HEIGHT;
+    forkJoin(fork,
+        [&]() { l = intersectionOf(al, bl, leftGarbage, forks - 1); },
+        [&]() { r = intersectionOf(ar, br, garbage, forks - 1); });
+    garbage.insert(garbage.end(), leftGarbage.begin(), leftGarbage.end());
+    return (m != NULL) ? join(l, m, r) : join2(l, r);
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree
+AVLTree<Key, Value, Counted>::differenceOf(const Subtree& a, const Subtree& b, std::vector<AVLNode<Key,Value>*>& garbage, int forks)
+{
+    if(a.root == NULL || b.root == NULL) {
+        discard(b.root, garbage);
+        return a;
+    }
+    Subtree bl, br, al, ar, l, r;
+    expose(b, bl, br);
+    AVLNode<Key,Value>* m;
+    splitAt(a, b.root->getKey(), al, m, ar);
+    garbage.push_back(b.root);
+    if(m != NULL) {
+        garbage.push_back(m);
+    }
+    std::vector<AVLNode<Key,Value>*> leftGarbage;
+    bool fork = forks > 0 && std::min(a.height, b.height) >= PARALLEL_MIN_HEIGHT;
+    forkJoin(fork,
+        [&]() { l = differenceOf(al, bl, leftGarbage, forks - 1); },
+        [&]() { r = differenceOf(ar, br, garbage, forks - 1); });
+    garbage.insert(garbage.end(), leftGarbage.begin(), leftGarbage.end());
+    return join2(l, r);
+}
+
+/*
+ * Builds the next n items of it in order: left half, middle, right half.
+ */
+template<class Key, class Value, bool Counted>
+template<typename ForwardIt>
+typename AVLTree<Key, Value, Counted>::Subtree AVLTree<Key, Value, Counted>::buildSubtree(ForwardIt& it, size_t n)
+{
+    if(n == 0) {
+        Subtree empty = { NULL, 0 };
+        return empty;
+    }
+    Subtree l = buildSubtree(it, n / 2);
+    AVLNode<Key,Value>* k = createNode(it->first, it->second, NULL);
+    ++it;
+    Subtree r = buildSubtree(it, n - 1 - n / 2);
+    return makeNode(l, k, r);
+}
+
+template<class Key, class Value, bool Counted>
+template<typename ForwardIt>
+void AVLTree<Key, Value, Counted>::buildFromSorted(ForwardIt first, ForwardIt last)
+{
+    size_t n = 0;
+    for(ForwardIt it = first; it != last; ++it, ++n) {
+        ForwardIt next = it;
+        ++next;
+        if(next != last && !(it->first < next->first)) {
+            throw std::invalid_argument("buildFromSorted: keys are not strictly increasing");
+        }
+    }
+    if(Counted && n > UINT32_MAX) {
+        throw std::length_error("AVLTree: too many items to count");
+    }
+    clear();
+    setRoot(buildSubtree(first, n));
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::setRoot(const Subtree& t)
+{
+    this->root_ = t.root;
+    if(t.root != NULL) {
+        t.root->setParent(NULL);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+typename AVLTree<Key, Value, Counted>::Subtree AVLTree<Key, Value, Counted>::whole() const
+{
+    AVLNode<Key,Value>* r = static_cast<AVLNode<Key,Value>*>(this->root_);
+    Subtree t = { r, height(r) };
+    return t;
+}
+
+template<class Key, class Value, bool Counted>
+std::shared_ptr<NodeArena<AVLNode<Key, Value> > > AVLTree<Key, Value, Counted>::sharedArena()
+{
+    static std::mutex lock;
+    static std::weak_ptr<NodeArena<AVLNode<Key, Value> > > current;
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<NodeArena<AVLNode<Key, Value> > > arena = current.lock();
+    if(!arena) {
+        arena = std::make_shared<NodeArena<AVLNode<Key, Value> > >(true);
+        current = arena;
+    }
+    return arena;
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::shareArena()
+{
+    if(!arena_->locking()) {
+        std::shared_ptr<NodeArena<AVLNode<Key, Value> > > shared = sharedArena();
+        shared->adopt(*arena_);
+        arena_ = shared;
+    }
+}
+
+/*
+ * Only the shared arena is ever held by more than one tree, so an arena
+ * that does not lock belongs to its tree alone and can be adopted whole.
+ */
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::takeNodes(AVLTree& other)
+{
+    if(other.arena_ == arena_) {
+        return;
+    }
+    shareArena();
+    if(!other.arena_->locking()) {
+        arena_->adopt(*other.arena_);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::split(const Key& key, AVLTree& right)
+{
+    if(&right == this) {
+        return;
+    }
+    right.clear();
+    shareArena();
+    right.arena_ = arena_;
+    Subtree l, r;
+    AVLNode<Key,Value>* mid;
+    splitAt(whole(), key, l, mid, r);
+    if(mid != NULL) {
+        Subtree empty = { NULL, 0 };
+        r = join(empty, mid, r);
+    }
+    setRoot(l);
+    right.setRoot(r);
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::join(AVLTree& right)
+{
+    if(&right == this || right.root_ == NULL) {
+        return;
+    }
+    if(this->root_ != NULL) {
+        Node<Key, Value>* last = this->root_;
+        while(last->getRight() != NULL) {
+            last = last->getRight();
+        }
+        Node<Key, Value>* first = right.root_;
+        while(first->getLeft() != NULL) {
+            first = first->getLeft();
+        }
+        if(!(last->getKey() < first->getKey())) {
+            throw std::invalid_argument("join: keys of right must follow those of this tree");
+        }
+    }
+    checkRoom(sizeOf(static_cast<AVLNode<Key,Value>*>(right.root_)));
+    takeNodes(right);
+    setRoot(join2(whole(), right.whole()));
+    right.root_ = NULL;
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::setOperation(AVLTree& other, unsigned threads, SetOp op)
+{
+    takeNodes(other);
+    std::vector<AVLNode<Key,Value>*> garbage;
+    setRoot(op(whole(), other.whole(), garbage, forkDepth(threads)));
+    other.root_ = NULL;
+    for(AVLNode<Key,Value>* n : garbage) {
+        destroyNode(n);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::unionWith(AVLTree& other, unsigned threads)
+{
+    if(&other != this) {
+        checkRoom(sizeOf(static_cast<AVLNode<Key,Value>*>(other.root_)));
+        setOperation(other, threads, &AVLTree::unionOf);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::intersectWith(AVLTree& other, unsigned threads)
+{
+    if(&other != this) {
+        setOperation(other, threads, &AVLTree::intersectionOf);
+    }
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::subtract(AVLTree& other, unsigned threads)
+{
+    if(&other == this) {
+        clear();
+    }
+    else {
+        setOperation(other, threads, &AVLTree::differenceOf);
+    }
+}
+
+/*
+ * Order statistics.  Each walks one root-to-leaf path, counting the
+ * left subtrees it passes.
+ */
+
+template<class Key, class Value, bool Counted>
+size_t AVLTree<Key, Value, Counted>::size() const
+{
+    static_assert(Counted, "size() needs an OrderStatisticsTree");
+    return sizeOf(static_cast<AVLNode<Key,Value>*>(this->root_));
+}
+
+template<class Key, class Value, bool Counted>
+size_t AVLTree<Key, Value, Counted>::rank(const Key& key) const
+{
+    static_assert(Counted, "rank() needs an OrderStatisticsTree");
+    size_t r = 0;
+    AVLNode<Key,Value>* n = static_cast<AVLNode<Key,Value>*>(this->root_);
+    while(n != NULL) {
+        if(n->getKey() < key) {
+            r += sizeOf(n->getLeft()) + 1;
+            n = n->getRight();
+        }
+        else {
+            n = n->getLeft();
+        }
+    }
+    return r;
+}
+
+template<class Key, class Value, bool Counted>
+typename BinarySearchTree<Key, Value>::iterator AVLTree<Key, Value, Counted>::select(size_t k) const
+{
+    static_assert(Counted, "select() needs an OrderStatisticsTree");
+    AVLNode<Key,Value>* n = static_cast<AVLNode<Key,Value>*>(this->root_);
+    if(k >= sizeOf(n)) {
+        return this->end();
+    }
+    while(true) {
+        size_t l = sizeOf(n->getLeft());
+        if(k < l) {
+            n = n->getLeft();
+        }
+        else if(k > l) {
+            k -= l + 1;
+            n = n->getRight();
+        }
+        else {
+            return NodeIterator(n);
+        }
+    }
+}
+
+template<class Key, class Value, bool Counted>
+size_t AVLTree<Key, Value, Counted>::countRange(const Key& lo, const Key& hi) const
+{
+    static_assert(Counted, "countRange() needs an OrderStatisticsTree");
+    if(!(lo < hi)) {
+        return 0;
+    }
+    return rank(hi) - rank(lo);
+}
+
+template<class Key, class Value, bool Counted>
+typename BinarySearchTree<Key, Value>::iterator AVLTree<Key, Value, Counted>::percentile(double p) const
+{
+    static_assert(Counted, "percentile() needs an OrderStatisticsTree");
+    if(!(p >= 0.0 && p <= 1.0)) {
+        throw std::invalid_argument("percentile: p must be in [0, 1]");
+    }
+    size_t n = size();
+    if(n == 0) {
+        return this->end();
+    }
+    // the smallest rank with at least a fraction p of the items at or below it
+    double at = std::ceil(p * n);
+    size_t k = (at < 1.0) ? 0 : std::min((size_t)at - 1, n - 1);
+    return select(k);
+}
+
+template<class Key, class Value, bool Counted>
+FrozenTree<Key, Value> AVLTree<Key, Value, Counted>::freeze() const
+{
+    FrozenTree<Key, Value> snapshot;
+    freeze(snapshot);
+    return snapshot;
+}
+
+template<class Key, class Value, bool Counted>
+void AVLTree<Key, Value, Counted>::freeze(FrozenTree<Key, Value>& snapshot) const
+{
+    snapshot.assign(this->begin(), this->end());
+}
+
+// AVLTree that keeps subtree sizes, for rank() and select()
+template<class Key, class Value>
+using OrderStatisticsTree = AVLTree<Key, Value, true>;
 
 #endif
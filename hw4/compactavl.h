@@ -0,0 +1,272 @@
+#ifndef COMPACTAVL_H
+#define COMPACTAVL_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbalance.h"
+
+/**
+* An AVL tree with the same operations as AVLTree, laid out for size rather than
+* for the BinarySearchTree interface. Nodes have no vtable and link to each other
+* by 32-bit indices into one vector, so a node is its item plus 13 bytes (24 bytes
+* for int keys and values, against 48 for an AVLNode plus allocator overhead),
+* and the whole tree is a single allocation that clear() frees at once.
+*
+* Removal keeps the vector dense by moving the last node into the freed slot, so
+* iterators are invalidated by remove() as well as by insert(). Rebalancing is
+* AVLTree's own, through AVLBalance with index links.
+*/
+template <typename Key, typename Value>
+class CompactAVLTree
+{
+public:
+    typedef std::pair<Key, Value> ItemType;
+
+    class iterator
+    {
+    public:
+        iterator() : tree_(NULL), current_(NIL) {}
+        const ItemType& operator*() const { return tree_->nodes_[current_].item; }
+        const ItemType* operator->() const { return &tree_->nodes_[current_].item; }
+        bool operator==(const iterator& rhs) const { return current_ == rhs.current_; }
+        bool operator!=(const iterator& rhs) const { return current_ != rhs.current_; }
+        iterator& operator++() { current_ = tree_->successor(current_); return *this; }
+    private:
+        friend class CompactAVLTree<Key, Value>;
+        iterator(const CompactAVLTree* tree, uint32_t current) : tree_(tree), current_(current) {}
+        const CompactAVLTree* tree_;
+        uint32_t current_;
+    };
+
+    CompactAVLTree() : root_(NIL) {}
+
+    // Inserts the item, or overwrites the value if the key is already present.
+    void insert(const std::pair<const Key, Value>& new_item);
+    // Removes key if present; a node with two children swaps items with its predecessor.
+    void remove(const Key& key);
+
+    iterator find(const Key& key) const { return iterator(this, findIndex(key)); }
+    iterator begin() const;
+    iterator end() const { return iterator(this, NIL); }
+    Value& operator[](const Key& key);
+    const Value& operator[](const Key& key) const;
+
+    size_t size() const { return nodes_.size(); }
+    bool empty() const { return nodes_.empty(); }
+    void clear() { std::vector<CompactNode>().swap(nodes_); root_ = NIL; }
+    void reserve(size_t n) { nodes_.reserve(n); }
+
+private:
+    static const uint32_t NIL = UINT32_MAX;
+
+    struct CompactNode {
+        ItemType item;
+        uint32_t left, right, parent;
+        int8_t balance;     // height(right) - height(left), as in AVLNode
+    };
+
+    uint32_t findIndex(const Key& key) const;
+    uint32_t successor(uint32_t n) const;
+    // Points p's link to old (or root_ when p is NIL) at n.
+    void replaceChild(uint32_t p, uint32_t old, uint32_t n);
+
+    // The tree's links as AVLBalance follows them
+    struct NodeAccess {
+        typedef uint32_t NodeRef;
+        CompactAVLTree* tree;
+        NodeRef nil() const { return NIL; }
+        NodeRef left(NodeRef n) const { return tree->nodes_[n].left; }
+        NodeRef right(NodeRef n) const { return tree->nodes_[n].right; }
+        NodeRef parent(NodeRef n) const { return tree->nodes_[n].parent; }
+        void setLeft(NodeRef n, NodeRef c) const { tree->nodes_[n].left = c; }
+        void setRight(NodeRef n, NodeRef c) const { tree->nodes_[n].right = c; }
+        void setParent(NodeRef n, NodeRef c) const { tree->nodes_[n].parent = c; }
+        int8_t balance(NodeRef n) const { return tree->nodes_[n].balance; }
+        void setBalance(NodeRef n, int8_t b) const { tree->nodes_[n].balance = b; }
+        void replaceChild(NodeRef p, NodeRef old, NodeRef n) const { tree->replaceChild(p, old, n); }
+        void rotated(NodeRef, NodeRef) const { }
+    };
+    typedef AVLBalance<NodeAccess> Balance;
+
+    std::vector<CompactNode> nodes_;
+    uint32_t root_;
+};
+
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::findIndex(const Key& key) const
+{
+    uint32_t n = root_;
+    while(n != NIL) {
+        const CompactNode& c = nodes_[n];
+        if(key < c.item.first) {
+            n = c.left;
+        }
+        else if(c.item.first < key) {
+            n = c.right;
+        }
+        else {
+            return n;
+        }
+    }
+    return NIL;
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::begin() const
+{
+    uint32_t n = root_;
+    while(n != NIL && nodes_[n].left != NIL) {
+        n = nodes_[n].left;
+    }
+    return iterator(this, n);
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLTree<Key, Value>::successor(uint32_t n) const
+{
+    if(nodes_[n].right != NIL) {
+        n = nodes_[n].right;
+        while(nodes_[n].left != NIL) {
+            n = nodes_[n].left;
+        }
+        return n;
+    }
+    uint32_t p = nodes_[n].parent;
+    while(p != NIL && nodes_[p].right == n) {
+        n = p;
+        p = nodes_[p].parent;
+    }
+    return p;
+}
+
+template<class Key, class Value>
+Value& CompactAVLTree<Key, Value>::operator[](const Key& key)
+{
+    uint32_t n = findIndex(key);
+    if(n == NIL) {
+        throw std::out_of_range("Invalid key");
+    }
+    return nodes_[n].item.second;
+}
+
+template<class Key, class Value>
+const Value& CompactAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    uint32_t n = findIndex(key);
+    if(n == NIL) {
+        throw std::out_of_range("Invalid key");
+    }
+    return nodes_[n].item.second;
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::replaceChild(uint32_t p, uint32_t old, uint32_t n)
+{
+    if(p == NIL) {
+        root_ = n;
+    }
+    else if(nodes_[p].left == old) {
+        nodes_[p].left = n;
+    }
+    else {
+        nodes_[p].right = n;
+    }
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    const Key& key = new_item.first;
+    uint32_t p = NIL;
+    uint32_t n = root_;
+    bool left = false;
+    while(n != NIL) {
+        CompactNode& c = nodes_[n];
+        p = n;
+        if(key < c.item.first) {
+            n = c.left;
+            left = true;
+        }
+        else if(c.item.first < key) {
+            n = c.right;
+            left = false;
+        }
+        else {
+            c.item.second = new_item.second;
+            return;
+        }
+    }
+    if(nodes_.size() >= NIL) {
+        throw std::length_error("CompactAVLTree: too many nodes");
+    }
+    n = nodes_.size();
+    CompactNode c = { ItemType(new_item.first, new_item.second), NIL, NIL, p, 0 };
+    nodes_.push_back(c);
+    if(p == NIL) {
+        root_ = n;
+        return;
+    }
+    if(left) {
+        nodes_[p].left = n;
+    }
+    else {
+        nodes_[p].right = n;
+    }
+    // p had one child before, so its height is unchanged
+    if(nodes_[p].balance != 0) {
+        nodes_[p].balance = 0;
+        return;
+    }
+    nodes_[p].balance = left ? -1 : 1;
+    NodeAccess a = { this };
+    Balance::insertFix(a, p, n);
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::remove(const Key& key)
+{
+    uint32_t n = findIndex(key);
+    if(n == NIL) {
+        return;
+    }
+    if(nodes_[n].left != NIL && nodes_[n].right != NIL) {
+        // nothing refers to items by node, so the items trade places instead
+        uint32_t pred = nodes_[n].left;
+        while(nodes_[pred].right != NIL) {
+            pred = nodes_[pred].right;
+        }
+        std::swap(nodes_[n].item, nodes_[pred].item);
+        n = pred;
+    }
+    uint32_t c = (nodes_[n].left != NIL) ? nodes_[n].left : nodes_[n].right;
+    uint32_t p = nodes_[n].parent;
+    int8_t diff = 0;
+    if(c != NIL) {
+        nodes_[c].parent = p;
+    }
+    if(p != NIL) {
+        diff = (nodes_[p].left == n) ? 1 : -1;
+    }
+    replaceChild(p, n, c);
+    NodeAccess a = { this };
+    Balance::removeFix(a, p, diff);
+
+    // move the last node into the hole
+    uint32_t last = nodes_.size() - 1;
+    if(n != last) {
+        CompactNode& m = nodes_[last];
+        replaceChild(m.parent, last, n);
+        if(m.left != NIL) {
+            nodes_[m.left].parent = n;
+        }
+        if(m.right != NIL) {
+            nodes_[m.right].parent = n;
+        }
+        nodes_[n] = std::move(m);
+    }
+    nodes_.pop_back();
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef FROZENTREE_H
+#define FROZENTREE_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+// Allocator for memory aligned to a 64-byte cache line
+template <typename T>
+struct CacheLineAllocator
+{
+    typedef T value_type;
+    CacheLineAllocator() {}
+    template<typename U>
+    CacheLineAllocator(const CacheLineAllocator<U>&) {}
+    T* allocate(size_t n)
+    {
+        void* p = NULL;
+        if(posix_memalign(&p, 64, n * sizeof(T)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { free(p); }
+    template<typename U>
+    bool operator==(const CacheLineAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const CacheLineAllocator<U>&) const { return false; }
+};
+
+/**
+* A read-only copy of an ordered map for lookup-heavy phases, made by AVLTree::freeze().
+* Keys are stored in Eytzinger (breadth-first) order in one array, 1-based, so the
+* children of slot k are slots 2k and 2k+1. A search is then a loop with no
+* data-dependent branch: it descends by k = 2k + (keys[k] < key) and, while doing so,
+* prefetches the cache line holding k's descendants a few levels down (the key array is
+* aligned to cache lines, and slot 0 is left unused, so those descendants fill exactly
+* one line when the size of Key is a power of two). The top levels of the tree share a
+* handful of lines that stay in cache. Values sit in a parallel array and are only
+* touched once the key is found.
+*
+* Key and Value must be default-constructible. assign() reuses the arrays, so
+* refreezing after a batch of updates allocates nothing unless the map has grown.
+*/
+template <typename Key, typename Value>
+class FrozenTree
+{
+public:
+    class iterator
+    {
+    public:
+        iterator() : tree_(NULL), k_(0) {}
+        const Key& key() const { return tree_->keys_[k_]; }
+        const Value& value() const { return tree_->values_[k_]; }
+        bool operator==(const iterator& rhs) const { return k_ == rhs.k_; }
+        bool operator!=(const iterator& rhs) const { return k_ != rhs.k_; }
+        iterator& operator++() { k_ = tree_->successor(k_); return *this; }
+    private:
+        friend class FrozenTree<Key, Value>;
+        iterator(const FrozenTree* tree, size_t k) : tree_(tree), k_(k) {}
+        const FrozenTree* tree_;
+        size_t k_;      // slot, or 0 for end()
+    };
+
+    FrozenTree() : n_(0) {}
+
+    /**
+    * Replaces the contents with the items in [first, last), which must be in
+    * increasing order of key, as pairs with first and second members. O(n).
+    */
+    template<typename ForwardIt>
+    void assign(ForwardIt first, ForwardIt last);
+
+    // The item with key, or end()
+    iterator find(const Key& key) const;
+    // The first item whose key is not less than key, or end()
+    iterator lowerBound(const Key& key) const { return iterator(this, lowerBoundSlot(key)); }
+    iterator begin() const { return iterator(this, first()); }
+    iterator end() const { return iterator(this, 0); }
+
+    size_t size() const { return n_; }
+    bool empty() const { return n_ == 0; }
+    void clear() { keys_.clear(); values_.clear(); n_ = 0; }
+
+private:
+    // Largest power of two no greater than keys, and at least 2
+    static constexpr size_t floorPow2(size_t keys) { return (keys <= 2) ? 2 : 2 * floorPow2(keys / 2); }
+    // The descendants of slot k log2(STRIDE) levels down are the STRIDE slots from
+    // k * STRIDE, as many keys as fit in a 64-byte cache line
+    static const size_t STRIDE = floorPow2(64 / sizeof(Key));
+
+    size_t lowerBoundSlot(const Key& key) const;
+    size_t first() const;
+    size_t successor(size_t k) const;
+
+    std::vector<Key, CacheLineAllocator<Key> > keys_;     // slot 0 is unused
+    std::vector<Value> values_;
+    size_t n_;
+};
+
+template<typename Key, typename Value>
+template<typename ForwardIt>
+void FrozenTree<Key, Value>::assign(ForwardIt first, ForwardIt last)
+{
+    size_t n = 0;
+    for(ForwardIt it = first; it != last; ++it) {
+        n++;
+    }
+    keys_.resize(n + 1);
+    values_.resize(n + 1);
+    n_ = n;
+    // visiting the slots in order of key hands them the items in order
+    for(size_t k = this->first(); k != 0; k = successor(k), ++first) {
+        keys_[k] = first->first;
+        values_[k] = first->second;
+    }
+}
+
+template<typename Key, typename Value>
+size_t FrozenTree<Key, Value>::lowerBoundSlot(const Key& key) const
+{
+    const Key* keys = keys_.data();
+    size_t k = 1;
+    while(k <= n_) {
+        __builtin_prefetch(keys + std::min(k * STRIDE, n_));
+        k = 2 * k + (keys[k] < key);
+    }
+    // k has fallen off the tree. Its bits are the turns taken (1 for right), and the
+    // answer is where the last left turn was made: strip the trailing right turns and it.
+    // If there was no left turn, every key is less and k becomes 0.
+    return k >> __builtin_ffsll(~k);
+}
+
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::find(const Key& key) const
+{
+    size_t k = lowerBoundSlot(key);
+    if(k != 0 && key < keys_[k]) {
+        k = 0;
+    }
+    return iterator(this, k);
+}
+
+template<typename Key, typename Value>
+size_t FrozenTree<Key, Value>::first() const
+{
+    if(n_ == 0) {
+        return 0;
+    }
+    size_t k = 1;
+    while(2 * k <= n_) {
+        k = 2 * k;
+    }
+    return k;
+}
+
+/*
+ * The leftmost slot of the right subtree if there is one, otherwise the
+ * nearest ancestor that k lies to the left of (0 past the last slot).
+ */
+template<typename Key, typename Value>
+size_t FrozenTree<Key, Value>::successor(size_t k) const
+{
+    if(2 * k + 1 <= n_) {
+        k = 2 * k + 1;
+        while(2 * k <= n_) {
+            k = 2 * k;
+        }
+        return k;
+    }
+    return k >> __builtin_ffsll(~k);
+}
+
+#endif
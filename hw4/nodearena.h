@@ -0,0 +1,146 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/**
+* Allocates fixed-size slots for objects of type T from slabs that double in size
+* (up to MAX_SLAB slots), so a tree of n nodes makes O(log n + n / MAX_SLAB) heap
+* allocations instead of n, and its nodes sit next to each other in memory.
+* A deallocated slot goes on a free list and is reused first. release() hands back
+* every slab at once, without visiting the slots.
+*
+* The arena only manages memory: objects are built with placement new and their
+* destructors must be run before their slots are deallocated or released.
+*
+* A locking arena serialises allocate(), deallocate() and adopt() on a mutex, so
+* it can serve objects used from several threads; a plain one has no such cost.
+*/
+template <typename T>
+class NodeArena
+{
+public:
+    explicit NodeArena(bool locking = false);
+    ~NodeArena();
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    // Returns uninitialised memory for one T.
+    void* allocate();
+    // Returns a slot obtained from allocate() to the free list.
+    void deallocate(void* p);
+    // Frees every slab; all slots become invalid.
+    void release();
+    // Takes over every slab of other, which is left empty, so objects allocated
+    // from other now live as long as this arena. other must not be in use elsewhere.
+    void adopt(NodeArena& other);
+    bool locking() const { return locking_; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+    static const size_t FIRST_SLAB = 64;
+    static const size_t MAX_SLAB = 65536;
+
+    std::vector<Slot*> slabs_;
+    Slot* free_;        // free list of deallocated slots
+    Slot* next_;        // unused part of the newest slab
+    Slot* end_;
+    size_t slabSlots_;  // size of the next slab
+    const bool locking_;
+    std::mutex mutex_;  // held by every allocation when locking_
+};
+
+template<typename T>
+NodeArena<T>::NodeArena(bool locking) :
+    free_(NULL), next_(NULL), end_(NULL), slabSlots_(FIRST_SLAB), locking_(locking)
+{
+
+}
+
+template<typename T>
+NodeArena<T>::~NodeArena()
+{
+    release();
+}
+
+template<typename T>
+void* NodeArena<T>::allocate()
+{
+    std::unique_lock<std::mutex> guard(mutex_, std::defer_lock);
+    if(locking_) {
+        guard.lock();
+    }
+    if(free_ != NULL) {
+        Slot* s = free_;
+        free_ = s->next;
+        return s;
+    }
+    if(next_ == end_) {
+        Slot* slab = static_cast<Slot*>(::operator new(slabSlots_ * sizeof(Slot)));
+        try {
+            slabs_.push_back(slab);
+        }
+        catch(...) {
+            ::operator delete(slab);
+            throw;
+        }
+        next_ = slab;
+        end_ = slab + slabSlots_;
+        if(slabSlots_ < MAX_SLAB) {
+            slabSlots_ *= 2;
+        }
+    }
+    return next_++;
+}
+
+template<typename T>
+void NodeArena<T>::deallocate(void* p)
+{
+    Slot* s = static_cast<Slot*>(p);
+    std::unique_lock<std::mutex> guard(mutex_, std::defer_lock);
+    if(locking_) {
+        guard.lock();
+    }
+    s->next = free_;
+    free_ = s;
+}
+
+template<typename T>
+void NodeArena<T>::release()
+{
+    for(Slot* slab : slabs_) {
+        ::operator delete(slab);
+    }
+    slabs_.clear();
+    free_ = next_ = end_ = NULL;
+    slabSlots_ = FIRST_SLAB;
+}
+
+template<typename T>
+void NodeArena<T>::adopt(NodeArena& other)
+{
+    std::unique_lock<std::mutex> guard(mutex_, std::defer_lock);
+    if(locking_) {
+        guard.lock();
+    }
+    slabs_.insert(slabs_.end(), other.slabs_.begin(), other.slabs_.end());
+    other.slabs_.clear();
+    while(other.free_ != NULL) {
+        Slot* s = other.free_;
+        other.free_ = s->next;
+        s->next = free_;
+        free_ = s;
+    }
+    // the unused tail of other's newest slab is given up; it comes back
+    // when this arena is released
+    other.next_ = other.end_ = NULL;
+    other.slabSlots_ = FIRST_SLAB;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "bitsetgraph.h"
+
+using namespace std;
+
+bool BitsetGraph::suitable(const CsrGraph& g)
+{
+    size_t n = g.numVertices();
+    return n > 0 && n <= MAX_VERTICES && g.numEdges() >= MIN_DENSITY * n * n;
+}
+
+BitsetGraph::BitsetGraph(const CsrGraph& g)
+    : n_(g.numVertices()), words_((g.numVertices() + 63) / 64), symmetric_(g.symmetric()),
+      rows_(n_ * words_, 0)
+{
+    if(!symmetric_) {
+        inRows_.assign(n_ * words_, 0);
+    }
+    for(VERTEX_ID_T u = 0; u < n_; ++u) {
+        for(VERTEX_ID_T v : g.neighbors(u)) {
+            set(rows_.data() + u * words_, v);
+            if(!symmetric_) {
+                set(inRows_.data() + v * words_, u);
+            }
+        }
+    }
+}
+
+size_t BitsetGraph::intersectionCount(const uint64_t* a, const uint64_t* b, size_t words)
+{
+    size_t count = 0;
+    size_t i = 0;
+#ifdef __AVX2__
+    // AVX2 has no popcount instruction: count each nibble with a 16-entry
+    // shuffle table and sum the bytes of every 64-bit lane with SAD
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i sums = _mm256_setzero_si256();
+    for(; i + 4 <= words; i += 4) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    count = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+            _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+#endif
+    for(; i < words; ++i) {
+        count += __builtin_popcountll(a[i] & b[i]);
+    }
+    return count;
+}
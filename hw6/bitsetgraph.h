@@ -0,0 +1,85 @@
+#ifndef BITSETGRAPH_H
+#define BITSETGRAPH_H
+#include <cstdint>
+#include <vector>
+#include "csrgraph.h"
+
+/**
+ * @brief Adjacency matrix of a CsrGraph as one bit row per vertex
+ *
+ * Edge tests are a single bit test, and neighbourhood questions become
+ * word-parallel operations on rows: counting the common members of two
+ * rows ANDs 64 vertices at a time (256 with AVX2) and popcounts them.
+ * Rows cost n bits each whatever the degree, so this only pays off for
+ * small, dense graphs; see suitable().
+ */
+class BitsetGraph {
+public:
+    // Largest graph kept as a matrix: two 4096 x 4096 bit matrices are 4 MiB
+    static const size_t MAX_VERTICES = 4096;
+    // Sparsest graph kept as a matrix, as average out-degree over n; at
+    // this density a row is as large as a CSR neighbour list
+    static constexpr double MIN_DENSITY = 1.0 / 32;
+
+    /**
+     * @brief True if g is small and dense enough that bit rows beat its
+     * CSR neighbour lists
+     */
+    static bool suitable(const CsrGraph& g);
+
+    explicit BitsetGraph(const CsrGraph& g);
+
+    size_t numVertices() const { return n_; }
+    // Length of every row (and of any bitset over the vertices) in words
+    size_t words() const { return words_; }
+
+    // Out-neighbours of u as a bit row
+    const uint64_t* row(VERTEX_ID_T u) const { return rows_.data() + u * words_; }
+    // In-neighbours of u as a bit row
+    const uint64_t* inRow(VERTEX_ID_T u) const
+    {
+        return symmetric_ ? row(u) : inRows_.data() + u * words_;
+    }
+
+    bool edgeExists(VERTEX_ID_T u, VERTEX_ID_T v) const { return test(row(u), v); }
+
+    static bool test(const uint64_t* bits, VERTEX_ID_T v)
+    {
+        return (bits[v >> 6] >> (v & 63)) & 1;
+    }
+    static void set(uint64_t* bits, VERTEX_ID_T v) { bits[v >> 6] |= (uint64_t)1 << (v & 63); }
+    static void reset(uint64_t* bits, VERTEX_ID_T v) { bits[v >> 6] &= ~((uint64_t)1 << (v & 63)); }
+
+    /**
+     * @brief Returns the number of bits set in both a and b, each words long
+     */
+    static size_t intersectionCount(const uint64_t* a, const uint64_t* b, size_t words);
+
+    /**
+     * @brief Calls f(v) for every bit v set in both a and b, in increasing
+     * order; stops early, returning false, if f returns false
+     */
+    template<typename F>
+    static bool forEachCommon(const uint64_t* a, const uint64_t* b, size_t words, F f)
+    {
+        for(size_t i = 0; i < words; ++i) {
+            uint64_t w = a[i] & b[i];
+            while(w != 0) {
+                if(!f((VERTEX_ID_T)(i * 64 + __builtin_ctzll(w)))) {
+                    return false;
+                }
+                w &= w - 1;
+            }
+        }
+        return true;
+    }
+
+private:
+    size_t n_;
+    size_t words_;
+    bool symmetric_;
+    std::vector<uint64_t> rows_;
+    std::vector<uint64_t> inRows_;    // left empty when symmetric_
+};
+
+#endif
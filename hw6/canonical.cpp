@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <memory>
+#include "canonical.h"
+#include "colorrefine.h"
+
+using namespace std;
+
+namespace {
+
+// Automorphisms kept for pruning off the first path.  Pruning stays
+// correct with any subset of them; more only prunes more.
+const size_t MAX_AUTOMORPHISMS = 64;
+
+// Depth-first individualisation-refinement over one graph.  The partition
+// of every search node is restored from the refinement trail rather than
+// copied, so memory stays linear in the graph plus the search depth.
+class CanonicalSearch
+{
+public:
+    explicit CanonicalSearch(const CsrGraph& g);
+    CanonicalForm run();
+
+private:
+    // A search node: the class whose vertices are individualised in turn
+    struct Frame {
+        uint32_t s, e;          // the class, as positions [s, e)
+        VERTEX_ID_T next;       // smallest vertex id not yet tried
+        VERTEX_ID_T chosen;     // vertex individualised for the current child
+        size_t mark;            // trail position of this node's partition
+        bool onFirst;           // node lies on the path to the first leaf
+    };
+
+    Frame node(bool onFirst) const;
+    VERTEX_ID_T findOrbit(VERTEX_ID_T v);
+    VERTEX_ID_T nextCandidate(size_t depth);
+    bool prunable(VERTEX_ID_T x, size_t depth);
+    void certify();
+    size_t leaf();
+    void addAutomorphism(const vector<VERTEX_ID_T>& order);
+
+    const CsrGraph& g_;
+    size_t n_;
+    ColorRefinement cr_;
+    vector<Frame> stack_;
+    vector<uint32_t> cert_;                 // certificate of the current leaf
+    vector<uint32_t> first_, best_;         // certificates of the first and best leaves
+    vector<VERTEX_ID_T> firstOrder_, bestOrder_;    // their vertex at each position
+    vector<VERTEX_ID_T> firstPath_;         // vertices individualised on the way to the first leaf
+    vector<vector<VERTEX_ID_T> > auts_;
+    // Orbits of every automorphism found, as a union-find whose roots are
+    // the smallest ids.  All of them fix the first path above the node
+    // currently branching on it, so they prune there without a cap.
+    vector<VERTEX_ID_T> orbits_;
+    vector<char> seen_;                     // orbit search marks; all zero between uses
+    vector<VERTEX_ID_T> orbit_;
+};
+
+CanonicalSearch::CanonicalSearch(const CsrGraph& g)
+    : g_(g), n_(g.numVertices()), cr_(g), orbits_(g.numVertices()), seen_(g.numVertices(), 0)
+{
+    for(VERTEX_ID_T v = 0; v < n_; ++v) {
+        orbits_[v] = v;
+    }
+}
+
+VERTEX_ID_T CanonicalSearch::findOrbit(VERTEX_ID_T v)
+{
+    while(orbits_[v] != v) {
+        orbits_[v] = orbits_[orbits_[v]];
+        v = orbits_[v];
+    }
+    return v;
+}
+
+CanonicalSearch::Frame CanonicalSearch::node(bool onFirst) const
+{
+    // target: the first of the smallest non-singleton classes
+    Frame f = { 0, 0, 0, INVALID_VERTEX, cr_.mark(), onFirst };
+    uint32_t best = UINT32_MAX;
+    for(uint32_t s = 0; s < n_; s += cr_.colorSize(s)) {
+        uint32_t size = cr_.colorSize(s);
+        if(size > 1 && size < best) {
+            best = size;
+            f.s = s;
+            f.e = s + size;
+        }
+    }
+    return f;
+}
+
+VERTEX_ID_T CanonicalSearch::nextCandidate(size_t depth)
+{
+    Frame& f = stack_[depth];
+    for(;;) {
+        // order within a class changes as it is refined below, so take
+        // the class members in id order instead
+        VERTEX_ID_T x = INVALID_VERTEX;
+        for(uint32_t i = f.s; i < f.e; ++i) {
+            VERTEX_ID_T v = cr_.vertexAt(i);
+            if(v >= f.next && v < x) {
+                x = v;
+            }
+        }
+        if(x == INVALID_VERTEX) {
+            return x;
+        }
+        f.next = x + 1;
+        // the first child has nothing smaller to repeat
+        if(f.chosen == INVALID_VERTEX || !prunable(x, depth)) {
+            return x;
+        }
+    }
+}
+
+bool CanonicalSearch::prunable(VERTEX_ID_T x, size_t depth)
+{
+    // x's subtree repeats an earlier one if an automorphism fixing this
+    // node's path maps x to a smaller id, all of which were already tried
+    // or pruned in turn
+    if(stack_[depth].onFirst) {
+        return findOrbit(x) < x;
+    }
+    if(auts_.empty()) {
+        return false;
+    }
+    vector<const vector<VERTEX_ID_T>*> fixing;
+    for(const auto& a : auts_) {
+        bool fixes = true;
+        for(size_t d = 0; d < depth && fixes; ++d) {
+            fixes = (a[stack_[d].chosen] == stack_[d].chosen);
+        }
+        if(fixes) {
+            fixing.push_back(&a);
+        }
+    }
+    bool smaller = false;
+    orbit_.assign(1, x);
+    seen_[x] = 1;
+    for(size_t i = 0; i < orbit_.size() && !smaller; ++i) {
+        for(const vector<VERTEX_ID_T>* a : fixing) {
+            VERTEX_ID_T y = (*a)[orbit_[i]];
+            if(!seen_[y]) {
+                seen_[y] = 1;
+                orbit_.push_back(y);
+                smaller = smaller || (y < x);
+            }
+        }
+    }
+    for(VERTEX_ID_T y : orbit_) {
+        seen_[y] = 0;
+    }
+    return smaller;
+}
+
+void CanonicalSearch::certify()
+{
+    cert_.clear();
+    cert_.push_back(n_);
+    for(uint32_t i = 0; i < n_; ++i) {
+        VertexRange r = g_.neighbors(cr_.vertexAt(i));
+        cert_.push_back(r.size());
+        size_t start = cert_.size();
+        for(VERTEX_ID_T w : r) {
+            cert_.push_back(cr_.color(0, w));
+        }
+        sort(cert_.begin() + start, cert_.end());
+    }
+}
+
+void CanonicalSearch::addAutomorphism(const vector<VERTEX_ID_T>& order)
+{
+    // both orderings give the same graph, so sending each vertex to the
+    // one at its position in the other ordering preserves every edge
+    vector<VERTEX_ID_T> a(n_);
+    for(VERTEX_ID_T v = 0; v < n_; ++v) {
+        a[v] = order[cr_.color(0, v)];
+        VERTEX_ID_T r1 = findOrbit(v), r2 = findOrbit(a[v]);
+        orbits_[max(r1, r2)] = min(r1, r2);
+    }
+    if(auts_.size() < MAX_AUTOMORPHISMS) {
+        auts_.push_back(std::move(a));
+    }
+}
+
+size_t CanonicalSearch::leaf()
+{
+    certify();
+    size_t depth = stack_.size();
+    if(firstOrder_.empty() && n_ > 0) {
+        first_ = best_ = cert_;
+        firstOrder_.resize(n_);
+        for(uint32_t i = 0; i < n_; ++i) {
+            firstOrder_[i] = cr_.vertexAt(i);
+        }
+        bestOrder_ = firstOrder_;
+        for(const Frame& f : stack_) {
+            firstPath_.push_back(f.chosen);
+        }
+        return depth;
+    }
+    if(cert_ == first_) {
+        // the subtree this leaf hangs in, below where its path leaves the
+        // first path, maps onto the one explored first: skip the rest of it
+        addAutomorphism(firstOrder_);
+        size_t d = 0;
+        while(d + 1 < depth && d < firstPath_.size() && stack_[d].chosen == firstPath_[d]) {
+            d++;
+        }
+        return d + 1;
+    }
+    if(cert_ < best_) {
+        best_ = cert_;
+        for(uint32_t i = 0; i < n_; ++i) {
+            bestOrder_[i] = cr_.vertexAt(i);
+        }
+    }
+    else if(cert_ == best_) {
+        addAutomorphism(bestOrder_);
+    }
+    return depth;
+}
+
+CanonicalForm CanonicalSearch::run()
+{
+    cr_.refine();
+    if(cr_.discrete()) {
+        leaf();
+    }
+    else {
+        stack_.push_back(node(true));
+    }
+    while(!stack_.empty()) {
+        size_t depth = stack_.size() - 1;
+        cr_.undo(stack_[depth].mark);
+        VERTEX_ID_T x = nextCandidate(depth);
+        if(x == INVALID_VERTEX) {
+            stack_.pop_back();
+            continue;
+        }
+        stack_[depth].chosen = x;
+        cr_.individualize(x);
+        cr_.refine();
+        if(cr_.discrete()) {
+            stack_.resize(leaf());
+        }
+        else {
+            const Frame& f = stack_[depth];
+            stack_.push_back(node(f.onFirst && (firstPath_.empty() || f.chosen == firstPath_[depth])));
+        }
+    }
+
+    CanonicalForm c;
+    if(n_ == 0) {
+        c.certificate = cert_;
+    }
+    else {
+        c.certificate.swap(best_);
+        c.labeling.resize(n_);
+        for(uint32_t i = 0; i < n_; ++i) {
+            c.labeling[bestOrder_[i]] = i;
+        }
+    }
+    // FNV-1a over the certificate words
+    c.hash = 14695981039346656037ULL;
+    for(uint32_t w : c.certificate) {
+        c.hash = (c.hash ^ w) * 1099511628211ULL;
+    }
+    return c;
+}
+
+}  // namespace
+
+CanonicalForm computeCanonicalForm(const CsrGraph& g)
+{
+    CanonicalSearch search(g);
+    return search.run();
+}
+
+const CanonicalForm& CsrGraph::canonicalForm() const
+{
+    shared_ptr<const CanonicalForm> c = atomic_load(&canonical_);
+    if(c == nullptr) {
+        // racing callers may each compute it, but only the first result
+        // is kept, so references handed out stay valid
+        shared_ptr<const CanonicalForm> mine = make_shared<const CanonicalForm>(computeCanonicalForm(*this));
+        if(atomic_compare_exchange_strong(&canonical_, &c, mine)) {
+            c = mine;
+        }
+    }
+    return *c;
+}
+
+bool canonicalIso(const CsrGraph& g1, const CsrGraph& g2, vector<VERTEX_ID_T>& map12)
+{
+    const CanonicalForm& c1 = g1.canonicalForm();
+    const CanonicalForm& c2 = g2.canonicalForm();
+    if(c1.hash != c2.hash || c1.certificate != c2.certificate) {
+        return false;
+    }
+    size_t n = g1.numVertices();
+    vector<VERTEX_ID_T> order2(n);
+    for(VERTEX_ID_T v = 0; v < n; ++v) {
+        order2[c2.labeling[v]] = v;
+    }
+    map12.resize(n);
+    for(VERTEX_ID_T u = 0; u < n; ++u) {
+        map12[u] = order2[c1.labeling[u]];
+    }
+    return true;
+}
+
+size_t GraphIndex::find(const CanonicalForm& c) const
+{
+    const pair<uint64_t, vector<uint32_t> >* bucket = buckets_.find(c.hash);
+    if(bucket != nullptr) {
+        for(uint32_t id : bucket->second) {
+            if(certs_[id] == c.certificate) {
+                return id;
+            }
+        }
+    }
+    return npos;
+}
+
+size_t GraphIndex::find(const CsrGraph& g) const
+{
+    return find(g.canonicalForm());
+}
+
+pair<size_t, bool> GraphIndex::insert(const CsrGraph& g)
+{
+    const CanonicalForm& c = g.canonicalForm();
+    size_t id = find(c);
+    if(id != npos) {
+        return make_pair(id, false);
+    }
+    id = certs_.size();
+    certs_.push_back(c.certificate);
+    buckets_.try_emplace(c.hash).first->second.push_back(id);
+    return make_pair(id, true);
+}
@@ -0,0 +1,83 @@
+#ifndef CANONICAL_H
+#define CANONICAL_H
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "csrgraph.h"
+#include "ht.h"
+
+/**
+ * @brief Canonical form of a graph: a relabelling of its vertices that
+ * depends only on its structure, so two graphs are isomorphic exactly when
+ * their canonical forms have equal certificates
+ */
+struct CanonicalForm {
+    // Canonical position of each vertex
+    std::vector<VERTEX_ID_T> labeling;
+    // The graph relabelled: its vertex count, then for each canonical
+    // position its out-degree and sorted out-neighbour positions
+    std::vector<uint32_t> certificate;
+    // Hash of the certificate
+    uint64_t hash;
+};
+
+/**
+ * @brief Computes the canonical form of g by individualisation-refinement
+ *
+ * Colour refinement splits the vertices into classes; while some class
+ * holds several vertices, each of them in turn is split off on its own and
+ * the result refined again.  Every branch ends in an ordering of all
+ * vertices, and the canonical one is the branch whose relabelled graph is
+ * smallest.  Branches that give the same graph reveal automorphisms, which
+ * prune vertices in the same orbit and whole subtrees equivalent to ones
+ * already seen.
+ *
+ * Most graphs need very few branches; highly symmetric ones can need
+ * many more, as with any method of this kind.
+ */
+CanonicalForm computeCanonicalForm(const CsrGraph& g);
+
+/**
+ * @brief Finds an isomorphism from g1 to g2 through their canonical forms,
+ * which CsrGraph memoises, instead of by search
+ *
+ * @return true if the graphs are isomorphic, with map12 as for csrGraphIso()
+ */
+bool canonicalIso(const CsrGraph& g1, const CsrGraph& g2, std::vector<VERTEX_ID_T>& map12);
+
+/**
+ * @brief Groups graphs into isomorphism classes by canonical certificate,
+ * so asking whether a graph is isomorphic to any seen before costs one
+ * canonical form and a hash lookup instead of a search per stored graph
+ */
+class GraphIndex
+{
+public:
+    static const size_t npos = SIZE_MAX;
+
+    /**
+     * @brief Returns the class of g, or npos if no graph isomorphic to g
+     * has been inserted
+     */
+    size_t find(const CsrGraph& g) const;
+
+    /**
+     * @brief Adds g's class if it is new
+     *
+     * @return the class id of g, and true if the class is new
+     */
+    std::pair<size_t, bool> insert(const CsrGraph& g);
+
+    // Number of classes
+    size_t size() const { return certs_.size(); }
+
+private:
+    size_t find(const CanonicalForm& c) const;
+
+    // certificate hash -> classes with that hash; certificates are
+    // compared in full, so colliding hashes cost time but never answers
+    HashTable<uint64_t, std::vector<uint32_t> > buckets_;
+    std::vector<std::vector<uint32_t> > certs_;   // per class
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <stdexcept>
+#include "colorrefine.h"
+
+using namespace std;
+
+ColorRefinement::ColorRefinement(const CsrGraph& g)
+    : count_(1), n1_(g.numVertices()), directed_(!g.symmetric())
+{
+    g_[0] = g_[1] = &g;
+    init();
+}
+
+ColorRefinement::ColorRefinement(const CsrGraph& g1, const CsrGraph& g2)
+    : count_(2), n1_(g1.numVertices()), directed_(!g1.symmetric() || !g2.symmetric())
+{
+    g_[0] = &g1;
+    g_[1] = &g2;
+    init();
+}
+
+void ColorRefinement::init()
+{
+    size_t total = n1_ + (count_ == 2 ? g_[1]->numVertices() : 0);
+    if(total >= UINT32_MAX) {
+        throw length_error("ColorRefinement: too many vertices");
+    }
+    uint32_t n = total;
+    perm_.resize(n);
+    key_.assign(n, 0);
+    for(uint32_t x = 0; x < n; ++x) {
+        perm_[x] = x;
+        const CsrGraph& g = *g_[x >= n1_];
+        VERTEX_ID_T v = (x >= n1_) ? x - n1_ : x;
+        key_[x] = ((uint64_t)g.degree(v) << 32) | g.inDegree(v);
+    }
+    // initial colours: (out, in) degree classes, in increasing order
+    stable_sort(perm_.begin(), perm_.end(),
+        [this](uint32_t a, uint32_t b) { return key_[a] < key_[b]; });
+    pos_.resize(n);
+    cellOf_.resize(n);
+    cellEnd_.assign(n, 0);
+    inFirst_.assign(n, 0);
+    inQueue_.assign(n, 0);
+    queue_.clear();
+    queueHead_ = 0;
+    cells_ = 0;
+    for(uint32_t i = 0; i < n; ) {
+        uint32_t j = i + 1;
+        while(j < n && key_[perm_[j]] == key_[perm_[i]]) {
+            j++;
+        }
+        for(uint32_t k = i; k < j; ++k) {
+            pos_[perm_[k]] = k;
+            cellOf_[perm_[k]] = i;
+            inFirst_[i] += (perm_[k] < n1_);
+        }
+        cellEnd_[i] = j;
+        cells_++;
+        enqueue(i);
+        i = j;
+    }
+    fill(key_.begin(), key_.end(), 0);
+    trail_.clear();
+}
+
+template<typename F>
+void ColorRefinement::forEachNeighbor(uint32_t w, bool out, F f) const
+{
+    uint32_t base = (w >= n1_) ? n1_ : 0;
+    const CsrGraph& g = *g_[w >= n1_];
+    VertexRange r = out ? g.neighbors(w - base) : g.inNeighbors(w - base);
+    for(VERTEX_ID_T x : r) {
+        f(base + x);
+    }
+}
+
+void ColorRefinement::enqueue(uint32_t s)
+{
+    if(!inQueue_[s]) {
+        inQueue_[s] = 1;
+        queue_.push_back(s);
+    }
+}
+
+bool ColorRefinement::split(uint32_t s, const uint32_t* lo, const uint32_t* hi)
+{
+    uint32_t e = cellEnd_[s];
+    uint32_t t = hi - lo;
+    if(t == e - s && key_[*lo] == key_[*(hi - 1)]) {
+        return true;    // every member has the same count
+    }
+    // Touched members go to the tail of the cell in key order, after the
+    // untouched ones (count 0); each run of equal keys becomes a cell.
+    // Only the tail is visited, so a split costs O(t), not O(e - s)
+    uint32_t tail = e;
+    for(const uint32_t* p = lo; p != hi; ++p) {
+        tail--;
+        uint32_t x = *p, y = perm_[tail];
+        swap(perm_[pos_[x]], perm_[tail]);
+        pos_[y] = pos_[x];
+        pos_[x] = tail;
+    }
+    for(const uint32_t* p = lo; p != hi; ++p, ++tail) {
+        perm_[tail] = *p;
+        pos_[*p] = tail;
+    }
+    record(s, e);
+    bool wasQueued = inQueue_[s];
+    uint32_t i = e - t;
+    if(i == s) {
+        // no untouched members; the first key run keeps start s
+        while(i < e && key_[perm_[i]] == key_[perm_[s]]) {
+            i++;
+        }
+    }
+    cellEnd_[s] = i;
+    uint32_t largest = s;
+    while(i < e) {
+        uint32_t j = i + 1;
+        while(j < e && key_[perm_[j]] == key_[perm_[i]]) {
+            j++;
+        }
+        inFirst_[i] = 0;
+        for(uint32_t k = i; k < j; ++k) {
+            cellOf_[perm_[k]] = i;
+            inFirst_[i] += (perm_[k] < n1_);
+        }
+        inFirst_[s] -= inFirst_[i];
+        cellEnd_[i] = j;
+        cells_++;
+        if(!balanced(i)) {
+            return false;
+        }
+        if(j - i > cellEnd_[largest] - largest) {
+            largest = i;
+        }
+        i = j;
+    }
+    if(!balanced(s)) {
+        return false;
+    }
+    // Hopcroft: counts into the largest piece follow from those into the
+    // others and into the old cell, so unless the old cell is still
+    // waiting in the queue the largest piece need not be a splitter
+    for(uint32_t c = s; c < e; c = cellEnd_[c]) {
+        if(wasQueued || c != largest) {
+            enqueue(c);
+        }
+    }
+    return true;
+}
+
+bool ColorRefinement::refine()
+{
+    for(uint32_t s = 0; count_ == 2 && s < perm_.size(); s = cellEnd_[s]) {
+        if(!balanced(s)) {
+            return false;
+        }
+    }
+    vector<uint32_t> members, touched;
+    while(queueHead_ < queue_.size()) {
+        uint32_t s = queue_[queueHead_++];
+        inQueue_[s] = 0;
+        members.assign(perm_.begin() + s, perm_.begin() + cellEnd_[s]);
+        touched.clear();
+        // key_ counts edges x -> S in its high half and S -> x in its low
+        // half; for undirected graphs the two are the same, so only one
+        for(uint32_t w : members) {
+            forEachNeighbor(w, false, [&](uint32_t x) {
+                if(key_[x] == 0) touched.push_back(x);
+                key_[x] += (uint64_t)1 << 32;
+            });
+            if(directed_) {
+                forEachNeighbor(w, true, [&](uint32_t x) {
+                    if(key_[x] == 0) touched.push_back(x);
+                    key_[x] += 1;
+                });
+            }
+        }
+        sort(touched.begin(), touched.end(), [this](uint32_t a, uint32_t b) {
+            return cellOf_[a] != cellOf_[b] ? cellOf_[a] < cellOf_[b] : key_[a] < key_[b];
+        });
+        bool ok = true;
+        for(size_t i = 0; i < touched.size() && ok; ) {
+            size_t j = i + 1;
+            while(j < touched.size() && cellOf_[touched[j]] == cellOf_[touched[i]]) {
+                j++;
+            }
+            ok = split(cellOf_[touched[i]], touched.data() + i, touched.data() + j);
+            i = j;
+        }
+        for(uint32_t x : touched) {
+            key_[x] = 0;
+        }
+        if(!ok) {
+            return false;
+        }
+    }
+    queue_.clear();
+    queueHead_ = 0;
+    return true;
+}
+
+void ColorRefinement::individualize(uint32_t v)
+{
+    uint32_t s = cellOf_[v];
+    uint32_t e = cellEnd_[s];
+    if(e - s == 1) {
+        return;
+    }
+    record(s, e);
+    uint32_t y = perm_[s];
+    perm_[pos_[v]] = y;
+    pos_[y] = pos_[v];
+    perm_[s] = v;
+    pos_[v] = s;
+    for(uint32_t k = s + 1; k < e; ++k) {
+        cellOf_[perm_[k]] = s + 1;
+    }
+    cellEnd_[s] = s + 1;
+    cellEnd_[s + 1] = e;
+    inFirst_[s + 1] = inFirst_[s] - (v < n1_);
+    inFirst_[s] = (v < n1_);
+    cells_++;
+    // as in split(): the rest of the class is the larger piece
+    if(inQueue_[s]) {
+        enqueue(s + 1);
+    }
+    enqueue(s);
+}
+
+void ColorRefinement::undo(size_t m)
+{
+    while(trail_.size() > m) {
+        uint32_t s = trail_.back().first;
+        uint32_t e = trail_.back().second;
+        trail_.pop_back();
+        for(uint32_t c = cellEnd_[s]; c < e; c = cellEnd_[c]) {
+            for(uint32_t k = c; k < cellEnd_[c]; ++k) {
+                cellOf_[perm_[k]] = s;
+            }
+            inFirst_[s] += inFirst_[c];
+            cells_--;
+        }
+        cellEnd_[s] = e;
+    }
+}
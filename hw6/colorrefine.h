@@ -0,0 +1,97 @@
+#ifndef COLORREFINE_H
+#define COLORREFINE_H
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "csrgraph.h"
+
+/**
+ * @brief Colour refinement (1-dimensional Weisfeiler-Leman) of one graph,
+ * or of two graphs jointly so that their colours can be compared.
+ *
+ * Vertices start coloured by their (out, in) degree.  refine() then splits
+ * colour classes until every vertex of a class has the same number of
+ * out- and in-neighbours in every class (the coarsest equitable
+ * partition), using a splitter queue so each vertex is re-examined only
+ * when a class next to it splits.
+ *
+ * Colours are positions in an ordering of all vertices in which each
+ * class is contiguous.  Every step depends only on the graph structure,
+ * so isomorphic graphs get the same colours on corresponding vertices.
+ *
+ * Classes only ever split into contiguous pieces, and each split is kept
+ * on a trail, so a search can individualise a vertex, refine, and undo
+ * back to an earlier mark in time proportional to the work undone.
+ */
+class ColorRefinement {
+public:
+    explicit ColorRefinement(const CsrGraph& g);
+    ColorRefinement(const CsrGraph& g1, const CsrGraph& g2);
+
+    /**
+     * @brief Refines to the coarsest equitable partition
+     *
+     * @return false if, for two graphs, some class ever holds a different
+     * number of vertices from each graph, in which case they cannot be
+     * isomorphic (refinement stops early and colours are partial)
+     */
+    bool refine();
+
+    /**
+     * @brief Splits v into a colour class of its own, at the start of its
+     * old class; call refine() afterwards to propagate
+     */
+    void individualize(uint32_t v);
+
+    // Trail position for undo()
+    size_t mark() const { return trail_.size(); }
+    /**
+     * @brief Merges every class split since mark() returned m back into
+     * its parent.  Only valid after refine() has returned true.
+     */
+    void undo(size_t m);
+
+    // Colour of vertex v of graph 0 or 1
+    uint32_t color(size_t graph, VERTEX_ID_T v) const { return cellOf_[graph * n1_ + v]; }
+    // Number of vertices of all graphs with the given colour
+    uint32_t colorSize(uint32_t c) const { return cellEnd_[c] - c; }
+    size_t numColors() const { return cells_; }
+    // True once every class is a single vertex
+    bool discrete() const { return cells_ == perm_.size(); }
+    // Vertex at position i of the ordering, in the joint numbering: graph
+    // 1's vertex v is n1 + v.  Order within a class is arbitrary.
+    uint32_t vertexAt(uint32_t i) const { return perm_[i]; }
+
+private:
+    void init();
+    // Calls f(x) for each vertex x with an edge x -> w (or, with out,
+    // w -> x), in the joint numbering
+    template<typename F>
+    void forEachNeighbor(uint32_t w, bool out, F f) const;
+    // Splits cell s by the counts in key_ of its touched members
+    // touched[lo, hi), which are sorted by key
+    bool split(uint32_t s, const uint32_t* lo, const uint32_t* hi);
+    // True if cell s holds as many vertices of each graph
+    bool balanced(uint32_t s) const { return count_ == 1 || 2 * inFirst_[s] == cellEnd_[s] - s; }
+    void enqueue(uint32_t s);
+    // Records that cell s, ending at e, was split
+    void record(uint32_t s, uint32_t e) { trail_.push_back(std::make_pair(s, e)); }
+
+    const CsrGraph* g_[2];
+    size_t count_;               // number of graphs, 1 or 2
+    uint32_t n1_;                // vertices of graph 0; graph 1's follow
+    bool directed_;
+    std::vector<uint32_t> perm_;     // all vertices, each cell contiguous
+    std::vector<uint32_t> pos_;      // index of each vertex in perm_
+    std::vector<uint32_t> cellOf_;   // start of each vertex's cell
+    std::vector<uint32_t> cellEnd_;  // end of the cell starting at each index
+    std::vector<uint32_t> inFirst_;  // graph 0 vertices in the cell starting at each index
+    std::vector<char> inQueue_;      // per cell start
+    std::vector<uint32_t> queue_;
+    size_t queueHead_;
+    std::vector<uint64_t> key_;      // edge counts into the current splitter
+    size_t cells_;
+    std::vector<std::pair<uint32_t, uint32_t> > trail_;   // (start, old end) per split
+};
+
+#endif
@@ -0,0 +1,551 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "csrgraph.h"
+
+using namespace std;
+
+CsrGraph::CsrGraph(std::istream& istr)
+{
+    EDGE_LIST_T edges;
+    vector<bool> isHead;
+    string aline;
+    while(getline(istr,aline))
+    {
+        istringstream iss(aline);
+        string u, v;
+        if(iss >> u){
+            VERTEX_ID_T uid = intern(u);
+            if(uid < isHead.size() && isHead[uid]) {
+                continue;
+            }
+            if(uid >= isHead.size()) {
+                isHead.resize(uid + 1);
+            }
+            isHead[uid] = true;
+            while(iss >> v)
+            {
+                edges.push_back(make_pair(uid, intern(v)));
+            }
+        }
+    }
+    requireVertices(isHead);
+    build(edges);
+}
+
+CsrGraph::CsrGraph(const Graph& g)
+{
+    EDGE_LIST_T edges;
+    VERTEX_LIST_T verts = g.vertices();
+    // intern the vertices first, so any later name is a neighbour only
+    for(const auto& u : verts)
+    {
+        intern(u);
+    }
+    vector<bool> isHead(names_.size(), true);
+    for(VERTEX_ID_T uid = 0; uid < verts.size(); ++uid)
+    {
+        for(const auto& v : g.neighbors(verts[uid]))
+        {
+            edges.push_back(make_pair(uid, intern(v)));
+        }
+    }
+    requireVertices(isHead);
+    build(edges);
+}
+
+VERTEX_ID_T CsrGraph::id(const VERTEX_T& name) const
+{
+    const pair<VERTEX_T, VERTEX_ID_T>* item = ids_.find(name);
+    return (item == nullptr) ? INVALID_VERTEX : item->second;
+}
+
+bool CsrGraph::edgeExists(VERTEX_ID_T u, VERTEX_ID_T v) const
+{
+    VertexRange r = neighbors(u);
+    return binary_search(r.begin(), r.end(), v);
+}
+
+VERTEX_ID_T CsrGraph::intern(const string& name)
+{
+    if(names_.size() == INVALID_VERTEX) {
+        throw length_error("CsrGraph: too many vertices");
+    }
+    auto r = ids_.try_emplace(name, (VERTEX_ID_T)names_.size());
+    if(r.second) {
+        names_.push_back(name);
+    }
+    return r.first->second;
+}
+
+VERTEX_ID_T CsrGraph::intern(string_view name)
+{
+    const pair<VERTEX_T, VERTEX_ID_T>* item = ids_.find(name);
+    return (item != nullptr) ? item->second : intern(string(name));
+}
+
+void CsrGraph::requireVertices(const vector<bool>& isHead) const
+{
+    for(size_t i = 0; i < names_.size(); ++i) {
+        if(i >= isHead.size() || !isHead[i]) {
+            throw invalid_argument("CsrGraph: neighbour " + names_[i] + " is not a vertex");
+        }
+    }
+}
+
+void CsrGraph::build(EDGE_LIST_T& edges)
+{
+    size_t n = names_.size();
+
+    // Renumber in name order
+    vector<VERTEX_ID_T> order(n);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(),
+        [this](VERTEX_ID_T a, VERTEX_ID_T b) { return names_[a] < names_[b]; });
+    vector<VERTEX_ID_T> rank(n);
+    vector<VERTEX_T> sorted(n);
+    for(size_t i = 0; i < n; ++i) {
+        rank[order[i]] = i;
+        sorted[i] = std::move(names_[order[i]]);
+    }
+    names_.swap(sorted);
+    for(auto& p : ids_) {
+        p.second = rank[p.second];
+    }
+
+    // Counting sort of the edges by source
+    offsets_.assign(n + 1, 0);
+    for(const auto& e : edges) {
+        offsets_[rank[e.first] + 1]++;
+    }
+    partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+    nbrs_.resize(edges.size());
+    vector<size_t> pos(offsets_.begin(), offsets_.end() - 1);
+    for(const auto& e : edges) {
+        nbrs_[pos[rank[e.first]]++] = rank[e.second];
+    }
+    EDGE_LIST_T().swap(edges);
+
+    // Sort each row and squeeze out repeated edges, as VERTEX_SET_T would
+    size_t out = 0;
+    size_t start = 0;
+    for(size_t u = 0; u < n; ++u) {
+        size_t end = offsets_[u + 1];
+        sort(nbrs_.begin() + start, nbrs_.begin() + end);
+        offsets_[u] = out;
+        for(size_t i = start; i < end; ++i) {
+            if(i == start || nbrs_[i] != nbrs_[i - 1]) {
+                nbrs_[out++] = nbrs_[i];
+            }
+        }
+        start = end;
+    }
+    offsets_[n] = out;
+    nbrs_.resize(out);
+    nbrs_.shrink_to_fit();
+
+    buildTranspose();
+}
+
+void CsrGraph::buildTranspose()
+{
+    size_t n = names_.size();
+    // Visiting sources in order leaves each in-row sorted
+    inOffsets_.assign(n + 1, 0);
+    for(VERTEX_ID_T v : nbrs_) {
+        inOffsets_[v + 1]++;
+    }
+    partial_sum(inOffsets_.begin(), inOffsets_.end(), inOffsets_.begin());
+    inNbrs_.resize(nbrs_.size());
+    vector<size_t> pos(inOffsets_.begin(), inOffsets_.end() - 1);
+    for(size_t u = 0; u < n; ++u) {
+        for(size_t i = offsets_[u]; i < offsets_[u + 1]; ++i) {
+            inNbrs_[pos[nbrs_[i]]++] = u;
+        }
+    }
+    symmetric_ = (inOffsets_ == offsets_ && inNbrs_ == nbrs_);
+    if(symmetric_) {
+        vector<size_t>().swap(inOffsets_);
+        vector<VERTEX_ID_T>().swap(inNbrs_);
+    }
+}
+
+// ================= File loading ===================
+
+namespace {
+
+// Read-only view of a whole file: mapped where the platform allows,
+// otherwise read into memory
+class FileView
+{
+public:
+    explicit FileView(const string& path);
+    ~FileView();
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    void* mapping_;
+    vector<char> buffer_;
+};
+
+FileView::FileView(const string& path) : data_(nullptr), size_(0), mapping_(nullptr)
+{
+#if defined(HT_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw runtime_error("cannot read " + path);
+    }
+    size_ = st.st_size;
+    if(size_ > 0) {
+        void* base = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(base == MAP_FAILED) {
+            ::close(fd);
+            throw runtime_error("cannot map " + path);
+        }
+        // parsing reads straight through once
+        madvise(base, size_, MADV_SEQUENTIAL);
+        mapping_ = base;
+        data_ = static_cast<const char*>(base);
+    }
+    ::close(fd);
+#else
+    ifstream in(path, ios::binary);
+    if(!in) {
+        throw runtime_error("cannot open " + path);
+    }
+    buffer_.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+FileView::~FileView()
+{
+#if defined(HT_HAVE_MMAP)
+    if(mapping_ != nullptr) {
+        munmap(mapping_, size_);
+    }
+#endif
+}
+
+// The characters operator>> treats as separators in the "C" locale
+inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// One chunk of a text file tokenised in place.  Names are numbered in
+// order of first appearance within the chunk; lines keep file order so
+// repeated vertex lines can be resolved when the chunks are merged.
+struct TextChunk {
+    // Keyed by string like CsrGraph::ids_: short names then sit inside
+    // the slots, where views into the file would send nearly every
+    // comparison to a different part of it
+    HashTable<string, VERTEX_ID_T, LinearProber, StringHash, equal_to<> > ids;   // name -> chunk id
+    vector<VERTEX_ID_T> heads;                  // per line: its vertex
+    vector<size_t> lineEnds;                    // per line: end of its targets
+    vector<VERTEX_ID_T> targets;                // neighbours, line after line
+
+    VERTEX_ID_T intern(string_view name)
+    {
+        const pair<string, VERTEX_ID_T>* item = ids.find(name);
+        if(item != nullptr) {
+            return item->second;
+        }
+        VERTEX_ID_T id = ids.size();
+        ids.insert(make_pair(string(name), id));
+        return id;
+    }
+    void parse(const char* p, const char* end);
+};
+
+void TextChunk::parse(const char* p, const char* end)
+{
+    while(p != end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(eol == nullptr) {
+            eol = end;
+        }
+        bool head = true;
+        while(p != eol) {
+            while(p != eol && isSeparator(*p)) {
+                ++p;
+            }
+            const char* tok = p;
+            while(p != eol && !isSeparator(*p)) {
+                ++p;
+            }
+            if(p == tok) {
+                break;
+            }
+            VERTEX_ID_T id = intern(string_view(tok, p - tok));
+            if(head) {
+                heads.push_back(id);
+                head = false;
+            }
+            else {
+                targets.push_back(id);
+            }
+        }
+        if(!head) {
+            lineEnds.push_back(targets.size());
+        }
+        p = (eol == end) ? end : eol + 1;
+    }
+}
+
+// Layout of a binary graph file: this header, then n + 1 name offsets
+// (uint64), the name bytes, n + 1 edge offsets (uint64) and m
+// neighbour ids (uint32), each array starting 8-byte aligned
+struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t numVertices;
+    uint64_t numEdges;
+    uint64_t nameBytes;
+};
+const char BINARY_MAGIC[8] = { 'C', 'S', 'R', 'G', '\0', 'B', 'I', 'N' };
+const uint32_t BINARY_VERSION = 1;
+
+inline uint64_t align8(uint64_t x)
+{
+    return (x + 7) & ~uint64_t(7);
+}
+
+}  // namespace
+
+CsrGraph CsrGraph::load(const string& path, unsigned threads)
+{
+    FileView file(path);
+    if(file.size() >= sizeof(BinaryHeader) && memcmp(file.data(), BINARY_MAGIC, 8) == 0) {
+        return loadBinary(path, file.data(), file.size());
+    }
+    return loadText(file.data(), file.size(), threads);
+}
+
+CsrGraph CsrGraph::loadText(const char* data, size_t len, unsigned threads)
+{
+    if(threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    // chunks of at least 1 MiB, cut just after a line break
+    const size_t MIN_CHUNK = 1 << 20;
+    size_t count = max<size_t>(1, min<size_t>(threads, len / MIN_CHUNK));
+    vector<const char*> cuts(count + 1, data + len);
+    cuts[0] = data;
+    for(size_t i = 1; i < count; ++i) {
+        const char* p = max(data + len / count * i, cuts[i - 1]);
+        const char* eol = static_cast<const char*>(memchr(p, '\n', data + len - p));
+        cuts[i] = (eol == nullptr) ? data + len : eol + 1;
+    }
+    vector<TextChunk> chunks(count);
+    vector<thread> pool;
+    vector<exception_ptr> errors(count);
+    auto work = [&](size_t i) {
+        try {
+            chunks[i].parse(cuts[i], cuts[i + 1]);
+        }
+        catch(...) {
+            errors[i] = current_exception();
+        }
+    };
+    for(size_t i = 1; i < count; ++i) {
+        pool.emplace_back(work, i);
+    }
+    work(0);
+    for(thread& t : pool) {
+        t.join();
+    }
+    for(const exception_ptr& e : errors) {
+        if(e) {
+            rethrow_exception(e);
+        }
+    }
+
+    // Merge in file order.  Only kept lines intern their names, so a name
+    // seen only on an ignored repeated line does not become a vertex.
+    CsrGraph g;
+    EDGE_LIST_T edges;
+    size_t total = 0;
+    for(const TextChunk& c : chunks) {
+        total += c.targets.size();
+    }
+    edges.reserve(total);
+    vector<bool> isHead;
+    vector<VERTEX_ID_T> global;
+    vector<const string*> names;
+
+    // If no vertex line of the first chunk repeats, every name in it is
+    // kept, so its table can become the graph's as it is
+    TextChunk& first = chunks[0];
+    isHead.resize(first.ids.size());
+    size_t next = 1;
+    for(VERTEX_ID_T u : first.heads) {
+        if(isHead[u]) {
+            next = 0;
+            break;
+        }
+        isHead[u] = true;
+    }
+    if(next == 1) {
+        g.names_.resize(first.ids.size());
+        for(const auto& item : first.ids) {
+            g.names_[item.second] = item.first;
+        }
+        g.ids_ = std::move(first.ids);
+        size_t begin = 0;
+        for(size_t line = 0; line < first.heads.size(); ++line) {
+            for(size_t i = begin; i < first.lineEnds[line]; ++i) {
+                edges.push_back(make_pair(first.heads[line], first.targets[i]));
+            }
+            begin = first.lineEnds[line];
+        }
+    }
+    else {
+        isHead.assign(isHead.size(), false);
+    }
+    for(; next < count; ++next) {
+        TextChunk& c = chunks[next];
+        names.resize(c.ids.size());
+        for(const auto& item : c.ids) {
+            names[item.second] = &item.first;
+        }
+        global.assign(names.size(), INVALID_VERTEX);
+        auto resolve = [&](VERTEX_ID_T id) {
+            if(global[id] == INVALID_VERTEX) {
+                global[id] = g.intern(*names[id]);
+            }
+            return global[id];
+        };
+        size_t begin = 0;
+        for(size_t line = 0; line < c.heads.size(); ++line) {
+            size_t end = c.lineEnds[line];
+            VERTEX_ID_T u = resolve(c.heads[line]);
+            if(u >= isHead.size()) {
+                isHead.resize(u + 1);
+            }
+            if(!isHead[u]) {
+                isHead[u] = true;
+                for(size_t i = begin; i < end; ++i) {
+                    edges.push_back(make_pair(u, resolve(c.targets[i])));
+                }
+            }
+            begin = end;
+        }
+        // release the chunk's token arrays as soon as they are merged
+        vector<VERTEX_ID_T>().swap(c.targets);
+        vector<size_t>().swap(c.lineEnds);
+    }
+    vector<TextChunk>().swap(chunks);
+    g.requireVertices(isHead);
+    g.build(edges);
+    return g;
+}
+
+CsrGraph CsrGraph::loadBinary(const string& path, const char* data, size_t len)
+{
+    BinaryHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    if(hdr.byteOrder != 0x01020304) {
+        throw runtime_error(path + " was written with a different byte order");
+    }
+    if(hdr.version != BINARY_VERSION) {
+        throw runtime_error(path + " has an unsupported graph format version");
+    }
+    uint64_t n = hdr.numVertices, m = hdr.numEdges;
+    if(n >= INVALID_VERTEX || m > len || hdr.nameBytes > len) {
+        throw runtime_error(path + " is not a valid graph file");
+    }
+    uint64_t nameOffsetsAt = align8(sizeof(BinaryHeader));
+    uint64_t namesAt = nameOffsetsAt + (n + 1) * sizeof(uint64_t);
+    uint64_t offsetsAt = align8(namesAt + hdr.nameBytes);
+    uint64_t nbrsAt = offsetsAt + (n + 1) * sizeof(uint64_t);
+    if(nbrsAt + m * sizeof(VERTEX_ID_T) > len) {
+        throw runtime_error(path + " is truncated");
+    }
+
+    CsrGraph g;
+    vector<uint64_t> nameOffsets(n + 1);
+    memcpy(nameOffsets.data(), data + nameOffsetsAt, (n + 1) * sizeof(uint64_t));
+    vector<uint64_t> offsets(n + 1);
+    memcpy(offsets.data(), data + offsetsAt, (n + 1) * sizeof(uint64_t));
+    g.nbrs_.resize(m);
+    memcpy(g.nbrs_.data(), data + nbrsAt, m * sizeof(VERTEX_ID_T));
+
+    // Check every invariant the CSR arrays carry, so a bad file is
+    // reported here rather than misbehaving later
+    bool ok = (nameOffsets[0] == 0 && nameOffsets[n] == hdr.nameBytes
+               && offsets[0] == 0 && offsets[n] == m);
+    g.names_.reserve(n);
+    for(uint64_t v = 0; ok && v < n; ++v) {
+        ok = nameOffsets[v] < nameOffsets[v + 1] && nameOffsets[v + 1] <= hdr.nameBytes
+             && offsets[v] <= offsets[v + 1] && offsets[v + 1] <= m;
+        if(!ok) {
+            break;
+        }
+        g.names_.emplace_back(data + namesAt + nameOffsets[v], nameOffsets[v + 1] - nameOffsets[v]);
+        ok = (v == 0 || g.names_[v - 1] < g.names_[v]);
+        for(uint64_t i = offsets[v]; ok && i < offsets[v + 1]; ++i) {
+            ok = g.nbrs_[i] < n && (i == offsets[v] || g.nbrs_[i - 1] < g.nbrs_[i]);
+        }
+    }
+    if(!ok) {
+        throw runtime_error(path + " is not a valid graph file");
+    }
+    g.offsets_.assign(offsets.begin(), offsets.end());
+    g.ids_.reserve(n);
+    for(uint64_t v = 0; v < n; ++v) {
+        g.ids_.insert(make_pair(g.names_[v], (VERTEX_ID_T)v));
+    }
+    g.buildTranspose();
+    return g;
+}
+
+void CsrGraph::saveBinary(const string& path) const
+{
+    size_t n = names_.size();
+    BinaryHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BINARY_MAGIC, 8);
+    hdr.version = BINARY_VERSION;
+    hdr.byteOrder = 0x01020304;
+    hdr.numVertices = n;
+    hdr.numEdges = nbrs_.size();
+    vector<uint64_t> nameOffsets(n + 1, 0);
+    for(size_t v = 0; v < n; ++v) {
+        nameOffsets[v + 1] = nameOffsets[v] + names_[v].size();
+    }
+    hdr.nameBytes = nameOffsets[n];
+    vector<uint64_t> offsets(offsets_.begin(), offsets_.end());
+    const char zeros[8] = { 0 };
+
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(zeros, align8(sizeof(hdr)) - sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(nameOffsets.data()), (n + 1) * sizeof(uint64_t));
+    for(const VERTEX_T& name : names_) {
+        out.write(name.data(), name.size());
+    }
+    out.write(zeros, align8(hdr.nameBytes) - hdr.nameBytes);
+    out.write(reinterpret_cast<const char*>(offsets.data()), (n + 1) * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(nbrs_.data()), nbrs_.size() * sizeof(VERTEX_ID_T));
+    if(!out.flush()) {
+        throw runtime_error("cannot write " + path);
+    }
+}
@@ -0,0 +1,157 @@
+#ifndef CSRGRAPH_H
+#define CSRGRAPH_H
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "graphiso.h"
+
+// Dense vertex id; ids run from 0 to numVertices()-1 in name order, so
+// they match the order of Graph::vertices()
+typedef uint32_t VERTEX_ID_T;
+const VERTEX_ID_T INVALID_VERTEX = UINT32_MAX;
+
+struct CanonicalForm;
+
+// A contiguous, sorted run of vertex ids
+struct VertexRange {
+    const VERTEX_ID_T* first;
+    const VERTEX_ID_T* last;
+    const VERTEX_ID_T* begin() const { return first; }
+    const VERTEX_ID_T* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+// Read-only graph in compressed sparse row form.  Vertex names are interned
+// to dense 32-bit ids and each vertex's out-neighbours are stored sorted
+// in one shared array, so neighbour scans walk contiguous memory and
+// edgeExists() is a binary search.  In-neighbours are kept the same way,
+// except for symmetric (undirected) graphs, where they equal the
+// out-neighbours and share their storage.
+class CsrGraph {
+public:
+    /**
+     * @brief Reads the same format as Graph: one line per vertex, the
+     * vertex name followed by its neighbours.  As in Graph, a repeated
+     * vertex line is ignored and only names that start a line are
+     * vertices.
+     *
+     * @throw std::invalid_argument If a neighbour has no line of its own,
+     * the name Graph::neighbors() would reject
+     */
+    explicit CsrGraph(std::istream& istr);
+
+    /**
+     * @brief Builds the CSR form of an existing Graph, with ids in the
+     * order of g.vertices()
+     *
+     * @throw std::invalid_argument If a neighbour is not one of
+     * g.vertices()
+     */
+    explicit CsrGraph(const Graph& g);
+
+    /**
+     * @brief Loads a graph from a file, either in the text format above or
+     * as written by saveBinary() (told apart by the binary header)
+     *
+     * Text is memory-mapped and tokenised in place: the file is cut at
+     * line breaks into one chunk per thread, each chunk is parsed with
+     * its own name table, and the chunks are then merged in file order,
+     * so the result equals reading the file with CsrGraph(std::istream&).
+     *
+     * @param threads Parsing threads; 0 uses every hardware thread
+     * @throw std::runtime_error If the file cannot be read, or is a
+     * malformed binary image
+     * @throw std::invalid_argument If a neighbour in a text file has no
+     * line of its own
+     */
+    static CsrGraph load(const std::string& path, unsigned threads = 0);
+
+    /**
+     * @brief Writes the graph in a compact binary form: the sorted names
+     * and the CSR edge arrays as stored, so load() only has to validate
+     * them and rebuild the name table and the transpose
+     *
+     * @throw std::runtime_error If the file cannot be written
+     */
+    void saveBinary(const std::string& path) const;
+
+    size_t numVertices() const { return names_.size(); }
+    size_t numEdges() const { return nbrs_.size(); }
+
+    // Name of vertex v
+    const VERTEX_T& name(VERTEX_ID_T v) const { return names_[v]; }
+
+    /**
+     * @brief Returns the id of the vertex with the given name, or
+     * INVALID_VERTEX if there is none
+     */
+    VERTEX_ID_T id(const VERTEX_T& name) const;
+
+    // Out-neighbours of u in increasing id order
+    VertexRange neighbors(VERTEX_ID_T u) const
+    {
+        VertexRange r = { nbrs_.data() + offsets_[u], nbrs_.data() + offsets_[u + 1] };
+        return r;
+    }
+    size_t degree(VERTEX_ID_T u) const { return offsets_[u + 1] - offsets_[u]; }
+
+    // In-neighbours of u in increasing id order
+    VertexRange inNeighbors(VERTEX_ID_T u) const
+    {
+        if(symmetric_) {
+            return neighbors(u);
+        }
+        VertexRange r = { inNbrs_.data() + inOffsets_[u], inNbrs_.data() + inOffsets_[u + 1] };
+        return r;
+    }
+    size_t inDegree(VERTEX_ID_T u) const { return inNeighbors(u).size(); }
+
+    // True if every edge u -> v has a reverse edge v -> u
+    bool symmetric() const { return symmetric_; }
+
+    // True if the edge u -> v exists
+    bool edgeExists(VERTEX_ID_T u, VERTEX_ID_T v) const;
+
+    /**
+     * @brief Returns the canonical form of the graph (see canonical.h),
+     * computing it on first use only; safe to call from several threads
+     */
+    const CanonicalForm& canonicalForm() const;
+
+private:
+    typedef std::vector<std::pair<VERTEX_ID_T, VERTEX_ID_T> > EDGE_LIST_T;
+
+    CsrGraph() : symmetric_(true) {}
+    static CsrGraph loadBinary(const std::string& path, const char* data, size_t len);
+    static CsrGraph loadText(const char* data, size_t len, unsigned threads);
+
+    // Returns the id of name, assigning the next free one if it is new
+    VERTEX_ID_T intern(const std::string& name);
+    VERTEX_ID_T intern(std::string_view name);
+    // Throws std::invalid_argument unless every interned name is marked
+    // in isHead, i.e. was a vertex and not only a neighbour
+    void requireVertices(const std::vector<bool>& isHead) const;
+    // Renumbers the interned vertices into name order and packs edges
+    // (given in interning ids) into the CSR arrays
+    void build(EDGE_LIST_T& edges);
+    // Fills the transposed arrays and symmetric_ from the out-arrays
+    void buildTranspose();
+
+    std::vector<VERTEX_T> names_;     // id -> name
+    HashTable<VERTEX_T, VERTEX_ID_T, LinearProber, StringHash, std::equal_to<> > ids_;  // name -> id
+    std::vector<size_t> offsets_;     // neighbours of u are nbrs_[offsets_[u], offsets_[u+1])
+    std::vector<VERTEX_ID_T> nbrs_;
+    // Transposed CSR arrays; left empty when symmetric_
+    std::vector<size_t> inOffsets_;
+    std::vector<VERTEX_ID_T> inNbrs_;
+    bool symmetric_;
+    mutable std::shared_ptr<const CanonicalForm> canonical_;   // set once, by canonicalForm()
+};
+
+#endif
@@ -1,6 +1,17 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <sstream>
+#include <thread>
+#include <tuple>
 #include "graphiso.h"
+#include "csrgraph.h"
+#include "graphiso_ext.h"
+#include "colorrefine.h"
+#include "bitsetgraph.h"
 
 using namespace std;
 
@@ -52,89 +63,697 @@ VERTEX_LIST_T Graph::vertices() const
 
 
 
-// To be completed
-bool isConsistent(const Graph& g1, const Graph& g2, VERTEX_ID_MAP_T& mapping)
+// ================= VF2++ style matching engine ===================
+//
+// Vertices of g1 are matched one at a time in a precomputed order: each
+// BFS component starts from its rarest, best connected vertex, and within
+// a BFS level the vertex with the most already-ordered neighbours goes
+// first, so every vertex after a component's root is constrained by a
+// matched neighbour.  Candidates for a vertex are then drawn from the g2
+// neighbours of one matched neighbour's image instead of from all of g2.
+//
+// Before searching, both graphs are colour-refined together (see
+// ColorRefinement): any colour held by a different number of vertices of
+// each graph proves them non-isomorphic without a search, and otherwise an
+// isomorphism must map every vertex to one of the same colour.  Colours
+// stand in for the missing vertex labels of VF2++.
+//
+// A candidate pair (u, v) must have the same colour and, in each edge
+// direction:
+//  - every matched neighbour of u maps to a neighbour of v, and both have
+//    the same number of matched neighbours (so no edge is added either),
+//  - for every colour, u and v have equally many unmatched neighbours of
+//    that colour on the frontier (adjacent to some matched vertex) and
+//    beyond it (VF2++'s label look-ahead).
+// Each test costs O(deg) per pair and the search keeps an explicit stack,
+// so its depth is not limited by the call stack.
+//
+// Small dense graphs are also kept as bit matrices (see BitsetGraph).
+// Their pairs then compare matched neighbour counts by popcounting each
+// row against a bitset of the matched vertices, and look up edges by bit,
+// before the look-ahead walks any neighbour list.
+
+namespace {
+
+// Search state of one depth: the candidates not yet tried
+struct Frame {
+    const VERTEX_ID_T* next;
+    const VERTEX_ID_T* end;
+};
+
+// Search plan shared by every search over the same pair of graphs:
+// colour classes, matching order and candidate anchors.  It is read-only
+// once prepare() succeeds, so parallel workers share one plan.
+class IsoMatcher
 {
-    // Feel free to change or remove this starter code
-    VERTEX_LIST_T g1verts = g1.vertices();
+public:
+    IsoMatcher(const CsrGraph& g1, const CsrGraph& g2);
+    // Computes the plan; false if the graphs are proven non-isomorphic
+    bool prepare();
+    bool run(vector<VERTEX_ID_T>& map12) const;
+    bool runParallel(vector<VERTEX_ID_T>& map12, unsigned threads, size_t splitDepth) const;
 
-    // cout << "-- isConsistent" << endl;
-    // for(const auto& g1v : g1verts) cout << "* " << g1v << ", " << mapping[g1v]  << endl;
+private:
+    friend class IsoSearch;
+    friend class IsoWorker;
 
-    for(const auto& g1u : g1verts)
+    // Where the candidates for order_[d] come from: the out- or
+    // in-neighbours of the image of an earlier neighbour, or failing
+    // that every g2 vertex of the same colour
+    struct Anchor {
+        VERTEX_ID_T w;      // INVALID_VERTEX if there is no earlier neighbour
+        bool out;           // candidates are out-neighbours of w's image
+    };
+
+    // Calls f(x) for every out- and (for directed graphs) in-neighbour x of u
+    template<typename F>
+    static void forEachNeighbor(const CsrGraph& g, VERTEX_ID_T u, F f);
+
+    bool refineColors();
+    void computeOrder();
+    void computeAnchors();
+    // Every g2 vertex with the colour of g1 vertex u
+    Frame sameColor(VERTEX_ID_T u) const
     {
-        // Check mappings for necessary vertices to see if there is any violation
-        // and return false
-        VERTEX_T g2u = mapping[g1u];
-        VERTEX_SET_T g1neighbors = g1.neighbors(g1u);
-        VERTEX_SET_T g2neighbors = g2.neighbors(g2u);
-        if (g1neighbors.size() != g2neighbors.size()) return false;
-        for (VERTEX_SET_T::iterator it=g1neighbors.begin(); it != g1neighbors.end(); it++){
-            VERTEX_SET_T::iterator jt = g2neighbors.find(mapping[*it]);
-            if (jt == g2neighbors.end()) return false;
+        Frame f = { byColor2_.data() + sigLo_[u], byColor2_.data() + sigHi_[u] };
+        return f;
+    }
+
+    const CsrGraph& g1_;
+    const CsrGraph& g2_;
+    size_t n_;
+    bool directed_;
+    vector<VERTEX_ID_T> byColor2_;      // g2 vertices sorted by colour
+    vector<size_t> sigLo_, sigHi_;      // per g1 vertex: its colour class in byColor2_
+    vector<size_t> class2_;             // per g2 vertex: start of its colour class
+    vector<VERTEX_ID_T> order_;         // matching order of g1 vertices
+    vector<Anchor> anchor_;             // per depth
+    // Bit matrices of both graphs if they are dense enough, else null
+    unique_ptr<BitsetGraph> bits1_, bits2_;
+};
+
+// One depth-first search over a plan: the partial mapping, the matched
+// neighbour counts behind the look-ahead, and the explicit stack.  The
+// search can start below the root, from a prefix of the matching order
+// that is already matched, which is how parallel tasks run.
+class IsoSearch
+{
+public:
+    explicit IsoSearch(const IsoMatcher& plan);
+
+    /**
+     * @brief Searches every extension of the current prefix (depths below
+     * base) that picks order_[base]'s image from first
+     *
+     * @return true with a complete mapping in mapping(); false once the
+     * subtree is exhausted or cancel is set
+     */
+    bool search(size_t base, Frame first, const atomic<bool>* cancel);
+    const vector<VERTEX_ID_T>& mapping() const { return map12_; }
+
+protected:
+    Frame candidates(size_t depth) const;
+    bool feasible(VERTEX_ID_T u, VERTEX_ID_T v) const;
+    // b1 and b2 are the bit rows of r1 and r2, if the plan has them
+    bool feasibleDir(VertexRange r1, VertexRange r2, const uint64_t* b1, const uint64_t* b2) const;
+    void match(VERTEX_ID_T u, VERTEX_ID_T v);
+    void unmatch(VERTEX_ID_T u);
+
+    const IsoMatcher& p_;
+    vector<VERTEX_ID_T> map12_, map21_;
+    vector<uint32_t> t1_, t2_;          // matched neighbours of each vertex
+    vector<uint64_t> mapped1_, mapped2_;    // matched vertices as bitsets, with the bit matrices
+    mutable vector<int32_t> lookahead_; // per (class, frontier) counts; all zero between uses
+    vector<Frame> frames_;              // per depth, valid from base_ to top_
+    size_t base_, top_;
+    // Set by IsoWorker: frames below splitDepth_ may be stolen, so they
+    // change only under lock_, as do base_ and shallowTop_ = min(top_, splitDepth_)
+    mutex* lock_;
+    size_t splitDepth_;
+    size_t shallowTop_;
+};
+
+IsoMatcher::IsoMatcher(const CsrGraph& g1, const CsrGraph& g2)
+    : g1_(g1), g2_(g2), n_(g1.numVertices()), directed_(!g1.symmetric() || !g2.symmetric())
+{
+}
+
+template<typename F>
+void IsoMatcher::forEachNeighbor(const CsrGraph& g, VERTEX_ID_T u, F f)
+{
+    for(VERTEX_ID_T x : g.neighbors(u)) {
+        f(x);
+    }
+    if(!g.symmetric()) {
+        for(VERTEX_ID_T x : g.inNeighbors(u)) {
+            f(x);
         }
     }
+}
+
+bool IsoMatcher::refineColors()
+{
+    if(g1_.symmetric() != g2_.symmetric()) {
+        return false;
+    }
+    ColorRefinement colors(g1_, g2_);
+    if(!colors.refine()) {
+        return false;
+    }
+    // every colour holds as many vertices of each graph, so sorting both
+    // by colour lines the classes up at the same positions
+    auto byColor = [&colors](size_t graph) {
+        return [&colors, graph](VERTEX_ID_T a, VERTEX_ID_T b) {
+            return colors.color(graph, a) < colors.color(graph, b);
+        };
+    };
+    vector<VERTEX_ID_T> byColor1(n_);
+    byColor2_.resize(n_);
+    for(size_t i = 0; i < n_; ++i) {
+        byColor1[i] = byColor2_[i] = i;
+    }
+    sort(byColor1.begin(), byColor1.end(), byColor(0));
+    sort(byColor2_.begin(), byColor2_.end(), byColor(1));
+    sigLo_.resize(n_);
+    sigHi_.resize(n_);
+    class2_.resize(n_);
+    for(size_t i = 0; i < n_; ) {
+        uint32_t c = colors.color(0, byColor1[i]);
+        size_t j = i + colors.colorSize(c) / 2;
+        for(size_t k = i; k < j; ++k) {
+            sigLo_[byColor1[k]] = i;
+            sigHi_[byColor1[k]] = j;
+            class2_[byColor2_[k]] = i;
+        }
+        i = j;
+    }
     return true;
 }
 
-// Add any helper functions you deem useful
+void IsoMatcher::computeOrder()
+{
+    order_.clear();
+    order_.reserve(n_);
+    vector<char> visited(n_, 0), ordered(n_, 0);
+    vector<uint32_t> conn(n_, 0);     // ordered neighbours of each vertex
+    auto rarity = [this](VERTEX_ID_T u) { return sigHi_[u] - sigLo_[u]; };
+    auto degree = [this](VERTEX_ID_T u) { return g1_.degree(u) + g1_.inDegree(u); };
+
+    // component roots: rarest colour first, then highest degree
+    vector<VERTEX_ID_T> roots(n_);
+    for(size_t i = 0; i < n_; ++i) {
+        roots[i] = i;
+    }
+    sort(roots.begin(), roots.end(), [&](VERTEX_ID_T a, VERTEX_ID_T b) {
+        if(rarity(a) != rarity(b)) return rarity(a) < rarity(b);
+        if(degree(a) != degree(b)) return degree(a) > degree(b);
+        return a < b;
+    });
+
+    // max-heap on (connections, degree, commonness reversed, id reversed),
+    // with stale entries skipped when popped
+    typedef tuple<uint32_t, size_t, size_t, VERTEX_ID_T> KEY_T;
+    auto key = [&](VERTEX_ID_T u) {
+        return KEY_T(conn[u], degree(u), SIZE_MAX - rarity(u), INVALID_VERTEX - u);
+    };
+    priority_queue<KEY_T> heap;
+    vector<VERTEX_ID_T> level, nextLevel;
+    size_t nextRoot = 0;
+    while(order_.size() < n_) {
+        while(visited[roots[nextRoot]]) {
+            nextRoot++;
+        }
+        visited[roots[nextRoot]] = 1;
+        level.assign(1, roots[nextRoot]);
+        while(!level.empty()) {
+            for(VERTEX_ID_T u : level) {
+                heap.push(key(u));
+            }
+            while(!heap.empty()) {
+                KEY_T top = heap.top();
+                heap.pop();
+                VERTEX_ID_T u = INVALID_VERTEX - get<3>(top);
+                if(ordered[u] || get<0>(top) != conn[u]) {
+                    continue;
+                }
+                ordered[u] = 1;
+                order_.push_back(u);
+                forEachNeighbor(g1_, u, [&](VERTEX_ID_T x) {
+                    conn[x]++;
+                    // visited but unordered means x is in the current level
+                    if(visited[x] && !ordered[x]) {
+                        heap.push(key(x));
+                    }
+                });
+            }
+            nextLevel.clear();
+            for(VERTEX_ID_T u : level) {
+                forEachNeighbor(g1_, u, [&](VERTEX_ID_T x) {
+                    if(!visited[x]) {
+                        visited[x] = 1;
+                        nextLevel.push_back(x);
+                    }
+                });
+            }
+            level.swap(nextLevel);
+        }
+    }
+}
 
-bool graphIsoRec(size_t idx, const Graph& g1, const Graph& g2, VERTEX_ID_MAP_T& mapping)
+void IsoMatcher::computeAnchors()
 {
-   if (idx >= g2.vertices().size()) {
-        VERTEX_LIST_T g1verts = g1.vertices();
+    vector<size_t> pos(n_);
+    for(size_t d = 0; d < n_; ++d) {
+        pos[order_[d]] = d;
+    }
+    anchor_.resize(n_);
+    for(size_t d = 0; d < n_; ++d) {
+        VERTEX_ID_T u = order_[d];
+        Anchor best = { INVALID_VERTEX, true };
+        size_t bestSize = SIZE_MAX;
+        // u -> w needs v -> image(w): v is an in-neighbour of the image,
+        // and images have the same colour, hence degrees, as their preimages
+        for(VERTEX_ID_T w : g1_.neighbors(u)) {
+            if(pos[w] < d && g1_.inDegree(w) < bestSize) {
+                best.w = w;
+                best.out = false;
+                bestSize = g1_.inDegree(w);
+            }
+        }
+        for(VERTEX_ID_T w : g1_.inNeighbors(u)) {
+            if(pos[w] < d && g1_.degree(w) < bestSize) {
+                best.w = w;
+                best.out = true;
+                bestSize = g1_.degree(w);
+            }
+        }
+        anchor_[d] = best;
+    }
+}
+
+IsoSearch::IsoSearch(const IsoMatcher& plan)
+    : p_(plan), map12_(plan.n_, INVALID_VERTEX), map21_(plan.n_, INVALID_VERTEX),
+      t1_(plan.n_, 0), t2_(plan.n_, 0), lookahead_(2 * plan.n_, 0), frames_(plan.n_),
+      base_(0), top_(0), lock_(nullptr), splitDepth_(0), shallowTop_(0)
+{
+    if(plan.bits1_ != nullptr) {
+        mapped1_.assign(plan.bits1_->words(), 0);
+        mapped2_.assign(plan.bits2_->words(), 0);
+    }
+}
+
+Frame IsoSearch::candidates(size_t depth) const
+{
+    const IsoMatcher::Anchor& a = p_.anchor_[depth];
+    Frame f;
+    if(a.w == INVALID_VERTEX) {
+        f = p_.sameColor(p_.order_[depth]);
+    }
+    else {
+        VertexRange r = a.out ? p_.g2_.neighbors(map12_[a.w]) : p_.g2_.inNeighbors(map12_[a.w]);
+        f.next = r.begin();
+        f.end = r.end();
+    }
+    return f;
+}
+
+bool IsoSearch::feasibleDir(VertexRange r1, VertexRange r2, const uint64_t* b1, const uint64_t* b2) const
+{
+    if(b1 != nullptr) {
+        size_t words = mapped1_.size();
+        if(BitsetGraph::intersectionCount(b1, mapped1_.data(), words) !=
+           BitsetGraph::intersectionCount(b2, mapped2_.data(), words)) {
+            return false;
+        }
+        bool kept = BitsetGraph::forEachCommon(b1, mapped1_.data(), words, [&](VERTEX_ID_T w) {
+            return BitsetGraph::test(b2, map12_[w]);
+        });
+        if(!kept) {
+            return false;
+        }
+    }
+    else {
+        size_t mapped1 = 0, mapped2 = 0;
+        for(VERTEX_ID_T w : r1) {
+            if(map12_[w] != INVALID_VERTEX) {
+                if(!binary_search(r2.begin(), r2.end(), map12_[w])) {
+                    return false;
+                }
+                mapped1++;
+            }
+        }
+        for(VERTEX_ID_T x : r2) {
+            if(map21_[x] != INVALID_VERTEX) {
+                mapped2++;
+            }
+        }
+        if(mapped1 != mapped2) {
+            return false;
+        }
+    }
+    // Count the unmatched neighbours of u up and those of v down; every
+    // touched count must end at zero, and is reset while checking
+    for(VERTEX_ID_T w : r1) {
+        if(map12_[w] == INVALID_VERTEX) {
+            lookahead_[2 * p_.sigLo_[w] + (t1_[w] > 0)]++;
+        }
+    }
+    for(VERTEX_ID_T x : r2) {
+        if(map21_[x] == INVALID_VERTEX) {
+            lookahead_[2 * p_.class2_[x] + (t2_[x] > 0)]--;
+        }
+    }
+    bool ok = true;
+    for(VERTEX_ID_T w : r1) {
+        if(map12_[w] == INVALID_VERTEX) {
+            int32_t& c = lookahead_[2 * p_.sigLo_[w] + (t1_[w] > 0)];
+            ok = ok && (c == 0);
+            c = 0;
+        }
+    }
+    for(VERTEX_ID_T x : r2) {
+        if(map21_[x] == INVALID_VERTEX) {
+            int32_t& c = lookahead_[2 * p_.class2_[x] + (t2_[x] > 0)];
+            ok = ok && (c == 0);
+            c = 0;
+        }
+    }
+    return ok;
+}
 
-        // for(const auto& g1v : g1verts) cout << "- " << g1v << ", " << mapping[g1v]  << endl;
-        return (isConsistent(g1, g2, mapping));
+bool IsoSearch::feasible(VERTEX_ID_T u, VERTEX_ID_T v) const
+{
+    if(map21_[v] != INVALID_VERTEX || p_.sigLo_[u] != p_.class2_[v]) {
+        return false;
     }
-    
-    if (idx > 0) {
-        VERTEX_T prevV1 = g1.vertices()[idx-1];
-        VERTEX_SET_T v1neighbors = g1.neighbors(prevV1);
-        VERTEX_SET_T v2neighbors = g2.neighbors(mapping[prevV1]);
-        if (v1neighbors.size() != v2neighbors.size()) {
-            // cout << "-false" << endl;
+    const BitsetGraph* b1 = p_.bits1_.get();
+    const BitsetGraph* b2 = p_.bits2_.get();
+    if(b1 != nullptr) {
+        if(b1->edgeExists(u, u) != b2->edgeExists(v, v)) {
+            return false;
+        }
+        if(!feasibleDir(p_.g1_.neighbors(u), p_.g2_.neighbors(v), b1->row(u), b2->row(v))) {
             return false;
-        } 
+        }
+        return !p_.directed_ ||
+               feasibleDir(p_.g1_.inNeighbors(u), p_.g2_.inNeighbors(v), b1->inRow(u), b2->inRow(v));
     }
+    if(p_.g1_.edgeExists(u, u) != p_.g2_.edgeExists(v, v)) {
+        return false;
+    }
+    if(!feasibleDir(p_.g1_.neighbors(u), p_.g2_.neighbors(v), nullptr, nullptr)) {
+        return false;
+    }
+    return !p_.directed_ || feasibleDir(p_.g1_.inNeighbors(u), p_.g2_.inNeighbors(v), nullptr, nullptr);
+}
 
-    for (size_t i = idx; i < g2.vertices().size(); ++i) {
-        // swap idx position and i (iteration)
-        VERTEX_T v1Idx = g1.vertices()[idx];
-        VERTEX_T v1i = g1.vertices()[i];
-        VERTEX_T tmp = mapping[v1Idx];
-        mapping.insert({v1Idx, mapping[v1i]});
-        mapping.insert({v1i, tmp});
+void IsoSearch::match(VERTEX_ID_T u, VERTEX_ID_T v)
+{
+    map12_[u] = v;
+    map21_[v] = u;
+    if(!mapped1_.empty()) {
+        BitsetGraph::set(mapped1_.data(), u);
+        BitsetGraph::set(mapped2_.data(), v);
+    }
+    IsoMatcher::forEachNeighbor(p_.g1_, u, [this](VERTEX_ID_T x) { t1_[x]++; });
+    IsoMatcher::forEachNeighbor(p_.g2_, v, [this](VERTEX_ID_T x) { t2_[x]++; });
+}
 
-        if(graphIsoRec(idx + 1, g1, g2, mapping)) return true;
+void IsoSearch::unmatch(VERTEX_ID_T u)
+{
+    VERTEX_ID_T v = map12_[u];
+    IsoMatcher::forEachNeighbor(p_.g1_, u, [this](VERTEX_ID_T x) { t1_[x]--; });
+    IsoMatcher::forEachNeighbor(p_.g2_, v, [this](VERTEX_ID_T x) { t2_[x]--; });
+    map12_[u] = INVALID_VERTEX;
+    map21_[v] = INVALID_VERTEX;
+    if(!mapped1_.empty()) {
+        BitsetGraph::reset(mapped1_.data(), u);
+        BitsetGraph::reset(mapped2_.data(), v);
+    }
+}
 
-        // revert the change after recursion swap idx and i
-        v1Idx = g1.vertices()[idx];
-        v1i = g1.vertices()[i];
-        tmp = mapping[v1Idx];
-        mapping.insert({v1Idx, mapping[v1i]});
-        mapping.insert({v1i, tmp});
+bool IsoSearch::search(size_t base, Frame first, const atomic<bool>* cancel)
+{
+    size_t n = p_.n_;
+    {
+        unique_lock<mutex> guard;
+        if(base < splitDepth_) {
+            guard = unique_lock<mutex>(*lock_);
+        }
+        base_ = base;
+        frames_[base] = first;
+        top_ = base + 1;
+        shallowTop_ = min(top_, splitDepth_);
+    }
+    while(top_ > base) {
+        if(cancel != nullptr && cancel->load(memory_order_relaxed)) {
+            return false;
+        }
+        size_t depth = top_ - 1;
+        unique_lock<mutex> guard;
+        if(depth < splitDepth_) {
+            guard = unique_lock<mutex>(*lock_);
+        }
+        VERTEX_ID_T u = p_.order_[depth];
+        if(map12_[u] != INVALID_VERTEX) {
+            unmatch(u);
+        }
+        Frame& f = frames_[depth];
+        while(f.next != f.end && !feasible(u, *f.next)) {
+            ++f.next;
+        }
+        if(f.next == f.end) {
+            top_--;
+        }
+        else {
+            match(u, *f.next++);
+            if(depth + 1 == n) {
+                return true;
+            }
+            frames_[top_++] = candidates(depth + 1);
+        }
+        if(guard.owns_lock()) {
+            shallowTop_ = min(top_, splitDepth_);
+        }
     }
     return false;
 }
 
-// // To be completed
-bool graphIso(const Graph& g1, const Graph& g2, VERTEX_ID_MAP_T& mapping)
+bool IsoMatcher::prepare()
 {
-    VERTEX_LIST_T g1verts = g1.vertices();
-    if(g1verts.size() != g2.vertices().size())
-    {
+    if(n_ != g2_.numVertices() || g1_.numEdges() != g2_.numEdges() || !refineColors()) {
         return false;
     }
-    // Add code here
-    for (size_t i = 0; i < g1.vertices().size(); i++) {
-        mapping.insert({g1.vertices()[i], g2.vertices()[i]});
+    computeOrder();
+    computeAnchors();
+    // equal vertex and edge counts, so both graphs qualify or neither does
+    if(BitsetGraph::suitable(g1_)) {
+        bits1_.reset(new BitsetGraph(g1_));
+        bits2_.reset(new BitsetGraph(g2_));
     }
-    return graphIsoRec(0, g1, g2, mapping);
+    return true;
+}
 
-    // Delete this and return the correct value...
-    // This is just placeholder to allow compilation
-    // return false;
+bool IsoMatcher::run(vector<VERTEX_ID_T>& map12) const
+{
+    map12.clear();
+    if(n_ == 0) {
+        return true;
+    }
+    IsoSearch s(*this);
+    if(!s.search(0, sameColor(order_[0]), nullptr)) {
+        return false;
+    }
+    map12 = s.mapping();
+    return true;
+}
+
+// State shared by the workers of one parallel search
+struct IsoShared {
+    atomic<bool> done;          // set once a mapping is found; cancels the rest
+    atomic<unsigned> busy;      // workers holding a task
+    mutex resultLock;
+    bool found;
+    vector<VERTEX_ID_T> result;
+};
+
+// Worker of a parallel search.  It runs one task at a time: a prefix of the
+// matching order with its images, and a range of candidates for the next
+// depth.  An idle worker steals the upper half of the untried candidates
+// of another worker's shallowest open frame, with the prefix leading to
+// it, so large subtrees near the root are split first.  Only frames above
+// splitDepth can be stolen, so deeper steps run without locking.
+class IsoWorker : public IsoSearch
+{
+public:
+    IsoWorker(const IsoMatcher& plan, size_t splitDepth);
+    // Gives the worker the whole search tree as its first task
+    void assignRoot(IsoShared& shared);
+    void run(vector<unique_ptr<IsoWorker> >& workers, size_t self, IsoShared& shared);
+
+private:
+    // Moves a task from this worker's frames to thief; false if none
+    bool stealInto(IsoWorker& thief, IsoShared& shared);
+
+    mutex mutex_;
+    bool hasTask_;
+    size_t taskBase_;
+    Frame task_;
+    vector<VERTEX_ID_T> taskPrefix_;    // images of order_[0, taskBase_)
+    size_t matchedPrefix_;              // prefix depths currently matched
+};
+
+IsoWorker::IsoWorker(const IsoMatcher& plan, size_t splitDepth)
+    : IsoSearch(plan), hasTask_(false), taskBase_(0), matchedPrefix_(0)
+{
+    lock_ = &mutex_;
+    splitDepth_ = splitDepth;
 }
 
+void IsoWorker::assignRoot(IsoShared& shared)
+{
+    hasTask_ = true;
+    taskBase_ = 0;
+    task_ = p_.sameColor(p_.order_[0]);
+    shared.busy++;
+}
 
+bool IsoWorker::stealInto(IsoWorker& thief, IsoShared& shared)
+{
+    lock_guard<mutex> guard(mutex_);
+    for(size_t d = base_; d < shallowTop_; ++d) {
+        Frame& f = frames_[d];
+        if(f.next == f.end) {
+            continue;
+        }
+        const VERTEX_ID_T* mid = f.next + (f.end - f.next) / 2;
+        thief.task_.next = mid;
+        thief.task_.end = f.end;
+        thief.taskBase_ = d;
+        thief.taskPrefix_.resize(d);
+        for(size_t k = 0; k < d; ++k) {
+            thief.taskPrefix_[k] = map12_[p_.order_[k]];
+        }
+        thief.hasTask_ = true;
+        // counted while this worker is still busy, so busy never drops
+        // to zero with work outstanding
+        shared.busy++;
+        f.end = mid;
+        return true;
+    }
+    return false;
+}
+
+void IsoWorker::run(vector<unique_ptr<IsoWorker> >& workers, size_t self, IsoShared& shared)
+{
+    size_t count = workers.size();
+    for(;;) {
+        if(hasTask_) {
+            // everything below the old prefix was unmatched on the way out
+            for(size_t k = 0; k < matchedPrefix_; ++k) {
+                unmatch(p_.order_[k]);
+            }
+            for(size_t k = 0; k < taskBase_; ++k) {
+                match(p_.order_[k], taskPrefix_[k]);
+            }
+            matchedPrefix_ = taskBase_;
+            hasTask_ = false;
+            if(search(taskBase_, task_, &shared.done)) {
+                lock_guard<mutex> guard(shared.resultLock);
+                if(!shared.found) {
+                    shared.found = true;
+                    shared.result = map12_;
+                }
+                shared.done = true;
+            }
+            shared.busy--;
+            continue;
+        }
+        if(shared.done || shared.busy == 0) {
+            return;
+        }
+        bool stolen = false;
+        for(size_t k = 1; k < count && !stolen; ++k) {
+            stolen = workers[(self + k) % count]->stealInto(*this, shared);
+        }
+        if(!stolen) {
+            this_thread::yield();
+        }
+    }
+}
+
+bool IsoMatcher::runParallel(vector<VERTEX_ID_T>& map12, unsigned threads, size_t splitDepth) const
+{
+    map12.clear();
+    if(n_ == 0) {
+        return true;
+    }
+    IsoShared shared;
+    shared.done = false;
+    shared.busy = 0;
+    shared.found = false;
+    vector<unique_ptr<IsoWorker> > workers;
+    for(unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(new IsoWorker(*this, min(splitDepth, n_)));
+    }
+    workers[0]->assignRoot(shared);
+    vector<thread> pool;
+    try {
+        for(unsigned i = 1; i < threads; ++i) {
+            pool.emplace_back([&workers, &shared, i]() { workers[i]->run(workers, i, shared); });
+        }
+    }
+    catch(...) {
+        shared.done = true;
+        for(thread& t : pool) {
+            t.join();
+        }
+        throw;
+    }
+    workers[0]->run(workers, 0, shared);
+    for(thread& t : pool) {
+        t.join();
+    }
+    if(!shared.found) {
+        return false;
+    }
+    map12.swap(shared.result);
+    return true;
+}
+
+}  // namespace
+
+bool csrGraphIso(const CsrGraph& g1, const CsrGraph& g2, vector<VERTEX_ID_T>& map12,
+                 const IsoOptions& options)
+{
+    IsoMatcher matcher(g1, g2);
+    if(!matcher.prepare()) {
+        return false;
+    }
+    unsigned threads = options.threads;
+    if(threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    if(threads == 1) {
+        return matcher.run(map12);
+    }
+    return matcher.runParallel(map12, threads, options.splitDepth);
+}
+
+bool graphIso(const Graph& g1, const Graph& g2, VERTEX_ID_MAP_T& mapping, const IsoOptions& options)
+{
+    CsrGraph c1(g1), c2(g2);
+    vector<VERTEX_ID_T> map12;
+    if(!csrGraphIso(c1, c2, map12, options)) {
+        return false;
+    }
+    for (VERTEX_ID_T u = 0; u < c1.numVertices(); u++) {
+        mapping.insert({c1.name(u), c2.name(map12[u])});
+    }
+    return true;
+}
+
+bool graphIso(const Graph& g1, const Graph& g2, VERTEX_ID_MAP_T& mapping)
+{
+    return graphIso(g1, g2, mapping, IsoOptions());
+}
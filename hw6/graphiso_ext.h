@@ -0,0 +1,36 @@
+#ifndef GRAPHISO_EXT_H
+#define GRAPHISO_EXT_H
+#include <vector>
+#include "csrgraph.h"
+
+// Isomorphism entry points working directly on CsrGraph ids, for callers
+// that keep graphs in CSR form.  graphIso() is built on these.
+
+// Tuning for the isomorphism search
+struct IsoOptions {
+    // Worker threads; 0 uses every hardware thread.  With one thread the
+    // search is sequential and its result deterministic.  With more, any
+    // valid mapping may be returned, whichever worker finds one first.
+    unsigned threads = 1;
+    // Search depths whose untried candidates idle workers may steal
+    size_t splitDepth = 16;
+};
+
+/**
+ * @brief Finds an isomorphism from g1 to g2, i.e. a bijection of their
+ * vertices under which u -> w is an edge of g1 exactly when
+ * map12[u] -> map12[w] is an edge of g2
+ *
+ * @param map12 Receives, on success, the g2 vertex matched to each g1
+ * vertex; left unspecified otherwise
+ * @return true if the graphs are isomorphic
+ */
+bool csrGraphIso(const CsrGraph& g1, const CsrGraph& g2, std::vector<VERTEX_ID_T>& map12,
+                 const IsoOptions& options = IsoOptions());
+
+/**
+ * @brief graphIso() with search options, e.g. to search in parallel
+ */
+bool graphIso(const Graph& g1, const Graph& g2, VERTEX_ID_MAP_T& mapping, const IsoOptions& options);
+
+#endif
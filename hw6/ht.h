@@ -3,9 +3,180 @@
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HT_HAVE_MMAP 1
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef size_t HASH_INDEX_T;
 
+// Control bytes are kept in an array parallel to the slot array.  A full
+// slot stores a 7-bit tag taken from its key's hash (always >= 0), so most
+// probes that land on another key are rejected without touching key memory.
+typedef int8_t CTRL_T;
+const CTRL_T CTRL_EMPTY = -128;
+const CTRL_T CTRL_DELETED = -2;
+// Number of control bytes examined at once by a group scan
+const HASH_INDEX_T GROUP_WIDTH = 16;
+
+// Bitmasks over GROUP_WIDTH consecutive control bytes (bit i <-> byte i)
+struct CtrlGroup {
+#ifdef __SSE2__
+    __m128i ctrl_;
+    explicit CtrlGroup(const CTRL_T* pos)
+        : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+    uint32_t match(CTRL_T c) const
+    {
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(c), ctrl_));
+    }
+    // Empty and deleted bytes are the ones with their sign bit set
+    uint32_t matchNotFull() const
+    {
+        return (uint32_t)_mm_movemask_epi8(ctrl_);
+    }
+#else
+    const CTRL_T* ctrl_;
+    explicit CtrlGroup(const CTRL_T* pos) : ctrl_(pos) {}
+    uint32_t match(CTRL_T c) const
+    {
+        uint32_t mask = 0;
+        for(HASH_INDEX_T i = 0; i < GROUP_WIDTH; ++i) {
+            mask |= (uint32_t)(ctrl_[i] == c) << i;
+        }
+        return mask;
+    }
+    uint32_t matchNotFull() const
+    {
+        uint32_t mask = 0;
+        for(HASH_INDEX_T i = 0; i < GROUP_WIDTH; ++i) {
+            mask |= (uint32_t)(ctrl_[i] < 0) << i;
+        }
+        return mask;
+    }
+#endif
+    uint32_t matchEmpty() const { return match(CTRL_EMPTY); }
+};
+
+inline unsigned lowestBit(uint32_t mask)
+{
+    return (unsigned)__builtin_ctz(mask);
+}
+
+// Hints that addr will be read soon; a no-op where unsupported
+inline void prefetch(const void* addr)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(addr);
+#else
+    (void)addr;
+#endif
+}
+
+// Keys hashed and prefetched together by the batch operations.  Large
+// enough to cover memory latency, small enough that the prefetched
+// lines are still cached when they are used.
+const size_t BATCH_WIDTH = 16;
+
+
+// Capacity policies: the table sizes a HashTable steps through as it grows
+// and the reduction of a hash to a home slot.  A HashTable uses the policy
+// named by its Prober's Capacity typedef.
+
+// Prime sizes, roughly doubling, as X(size) entries so that each table
+// below is built from the one list
+#define HT_PRIME_CAPACITIES(X) \
+    X(11) X(23) X(47) X(97) X(197) X(397) X(797) X(1597) X(3203) X(6421) X(12853) \
+    X(25717) X(51437) X(102877) X(205759) X(411527) X(823117) X(1646237) X(3292489) \
+    X(6584983) X(13169977) X(26339969) X(52679969) X(105359969) X(210719881) \
+    X(421439783) X(842879579) X(1685759167)
+#define HT_CAPACITY_ENTRY(d) d,
+#define HT_COUNT_ENTRY(d) + 1
+// Lemire fastmod constant M = floor((2^128 - 1) / d) + 1 for size d; 128
+// bits of M make the remainder exact for every 64-bit hash
+#define HT_FASTMOD_ENTRY(d) ~(unsigned __int128)0 / (d) + 1,
+
+const HASH_INDEX_T NUM_PRIME_CAPACITIES = 0 HT_PRIME_CAPACITIES(HT_COUNT_ENTRY);
+
+// The tables are static members of a class template so that every
+// translation unit shares one definition
+template<typename T = void>
+struct PrimeTables {
+    static const HASH_INDEX_T CAPACITIES[NUM_PRIME_CAPACITIES];
+#if defined(__SIZEOF_INT128__)
+    static const unsigned __int128 FASTMOD[NUM_PRIME_CAPACITIES];
+#endif
+};
+
+template<typename T>
+const HASH_INDEX_T PrimeTables<T>::CAPACITIES[NUM_PRIME_CAPACITIES] =
+    { HT_PRIME_CAPACITIES(HT_CAPACITY_ENTRY) };
+
+#if defined(__SIZEOF_INT128__)
+template<typename T>
+const unsigned __int128 PrimeTables<T>::FASTMOD[NUM_PRIME_CAPACITIES] =
+    { HT_PRIME_CAPACITIES(HT_FASTMOD_ENTRY) };
+#endif
+
+#undef HT_FASTMOD_ENTRY
+#undef HT_COUNT_ENTRY
+#undef HT_CAPACITY_ENTRY
+#undef HT_PRIME_CAPACITIES
+
+// Prime sizes.  The reduction is exactly hash % m, but where 128-bit
+// integers exist it uses the precomputed fastmod constant, replacing the
+// 64-bit division with three multiplications.
+struct PrimeCapacity {
+    static const HASH_INDEX_T count = NUM_PRIME_CAPACITIES;
+    static HASH_INDEX_T size(HASH_INDEX_T mIndex) { return PrimeTables<>::CAPACITIES[mIndex]; }
+    static HASH_INDEX_T reduce(HASH_INDEX_T hash, HASH_INDEX_T mIndex)
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 low = PrimeTables<>::FASTMOD[mIndex] * hash;
+        uint64_t d = PrimeTables<>::CAPACITIES[mIndex];
+        // high 64 bits of the 192-bit product low * d
+        unsigned __int128 mid = ((low & ~(uint64_t)0) * d) >> 64;
+        return (HASH_INDEX_T)((mid + (low >> 64) * d) >> 64);
+#else
+        return hash % PrimeTables<>::CAPACITIES[mIndex];
+#endif
+    }
+};
+
+// Power-of-two sizes reduced with a mask.  Cheapest reduction, but only
+// the low bits of the hash choose the slot, so pair it with a hash
+// function whose low bits are well mixed.
+struct Pow2Capacity {
+    static const HASH_INDEX_T count = 28;
+    static HASH_INDEX_T size(HASH_INDEX_T mIndex) { return (HASH_INDEX_T)16 << mIndex; }
+    static HASH_INDEX_T reduce(HASH_INDEX_T hash, HASH_INDEX_T mIndex)
+    {
+        return hash & (size(mIndex) - 1);
+    }
+};
 
 // Complete - Base Prober class
 struct Prober {
@@ -14,18 +185,32 @@ struct Prober {
     HASH_INDEX_T m_;         // table size
     HASH_INDEX_T numProbes_; // probe attempts for statistic tracking
     static const HASH_INDEX_T npos = (HASH_INDEX_T)-1; // used to indicate probing failed
+    // true if next() visits consecutive slots, letting the table scan a
+    // whole group of control bytes per step instead of calling next()
+    static const bool contiguous = false;
+    // true if insertion should keep runs ordered by displacement (Robin
+    // Hood hashing); requires a contiguous probe sequence
+    static const bool robinHood = false;
+    typedef PrimeCapacity Capacity;
     void init(HASH_INDEX_T start, HASH_INDEX_T m) 
     {
         start_ = start;
         m_ = m;
         numProbes_ = 0;
     }
+    // The table always calls this form; probers that derive their step
+    // from the full hash override it
+    void init(HASH_INDEX_T start, HASH_INDEX_T m, HASH_INDEX_T /*hash*/)
+    {
+        init(start, m);
+    }
     HASH_INDEX_T next() {
         throw std::logic_error("Not implemented...should use derived class");
     }
 };
 
 struct LinearProber : public Prober {
+    static const bool contiguous = true;
 
     HASH_INDEX_T next() 
     {
@@ -34,7 +219,10 @@ struct LinearProber : public Prober {
         if(numProbes_ == m_) {
             return npos; 
         }
-        HASH_INDEX_T loc = (start_ + numProbes_) % m_;
+        // start_ and numProbes_ are both below m_, so one subtraction
+        // replaces the modulus
+        HASH_INDEX_T loc = start_ + numProbes_;
+        if(loc >= m_) loc -= m_;
         numProbes_++;
         return loc;
     }
@@ -42,6 +230,8 @@ struct LinearProber : public Prober {
 
 // To be completed
 struct QuadraticProber : public Prober {
+    HASH_INDEX_T loc_;
+
     HASH_INDEX_T next() 
     {
         // In quadratic probing with a prime table size,
@@ -50,10 +240,199 @@ struct QuadraticProber : public Prober {
         if(numProbes_ > (HASH_INDEX_T)m_/2) {
             return npos; 
         }
-        HASH_INDEX_T loc = (start_ + (HASH_INDEX_T)pow(numProbes_, 2)) % m_;
+        // start + i^2 is reached from start + (i-1)^2 by adding 2i-1 < m
+        if(numProbes_ == 0) {
+            loc_ = start_;
+        }
+        else {
+            loc_ += 2*numProbes_ - 1;
+            if(loc_ >= m_) loc_ -= m_;
+        }
         numProbes_++;
-        return loc;
+        return loc_;
+    }
+};
+
+// Linear probing over power-of-two capacities
+struct Pow2LinearProber : public LinearProber {
+    typedef Pow2Capacity Capacity;
+};
+
+// Quadratic probing by triangular numbers, start + i(i+1)/2, over
+// power-of-two capacities.  Unlike QuadraticProber on primes this visits
+// every slot, so probing never fails while a free slot exists.
+struct TriangularProber : public Prober {
+    typedef Pow2Capacity Capacity;
+    HASH_INDEX_T loc_;
+
+    HASH_INDEX_T next()
+    {
+        if(numProbes_ == m_) {
+            return npos;
+        }
+        loc_ = (numProbes_ == 0) ? start_ : ((loc_ + numProbes_) & (m_ - 1));
+        numProbes_++;
+        return loc_;
+    }
+};
+
+// Double hashing over prime capacities: the step is derived from hash
+// bits independent of the home slot, so keys sharing a home slot follow
+// different sequences.  Any step in [1, m-1] visits every slot of a
+// prime-sized table.
+struct DoubleHashProber : public Prober {
+    HASH_INDEX_T loc_;
+    HASH_INDEX_T step_;
+
+    void init(HASH_INDEX_T start, HASH_INDEX_T m, HASH_INDEX_T hash)
+    {
+        Prober::init(start, m);
+        uint64_t h2 = (uint64_t)(hash * 0x9E3779B97F4A7C15ull) >> 32;
+        step_ = 1 + (HASH_INDEX_T)(h2 % (m - 1));
+    }
+    HASH_INDEX_T next()
+    {
+        if(numProbes_ == m_) {
+            return npos;
+        }
+        if(numProbes_ == 0) {
+            loc_ = start_;
+        }
+        else {
+            loc_ += step_;
+            if(loc_ >= m_) loc_ -= m_;
+        }
+        numProbes_++;
+        return loc_;
+    }
+};
+
+// Linear probing with Robin Hood insertion: a new key takes the slot of
+// the first resident that is closer to its own home slot, and the rest of
+// the run shifts along by one.  Lookups are unchanged, but probe lengths
+// even out, shortening the longest runs.
+struct RobinHoodProber : public LinearProber {
+    static const bool robinHood = true;
+};
+
+// void, for detecting members by SFINAE (std::void_t before C++17)
+template<typename...>
+struct MakeVoid { typedef void type; };
+template<typename... T>
+using VoidT = typename MakeVoid<T...>::type;
+
+// True if a hash or equality functor declares is_transparent, i.e. it
+// accepts types other than the key type itself
+template<typename T, typename = void>
+struct IsTransparent : std::false_type {};
+template<typename T>
+struct IsTransparent<T, VoidT<typename T::is_transparent> > : std::true_type {};
+
+// Seed of a hash functor that exposes one through seed(), or 0.  Stored
+// in snapshots so that an image is never probed with a different hash.
+template<typename H, typename = void>
+struct HasherSeed {
+    static uint64_t get(const H&) { return 0; }
+};
+template<typename H>
+struct HasherSeed<H, VoidT<decltype(std::declval<const H&>().seed())> > {
+    static uint64_t get(const H& h) { return (uint64_t)h.seed(); }
+};
+
+// FNV-1a hash of the compiler's name for T.  Stored in snapshots so that
+// an image is never read as a different type of the same size; names are
+// only comparable between builds with the same compiler ABI.
+template<typename T>
+uint64_t typeFingerprint()
+{
+    uint64_t h = 14695981039346656037ull;
+    for(const char* c = typeid(T).name(); *c != '\0'; ++c) {
+        h = (h ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    return h;
+}
+
+#if __cplusplus >= 201703L
+// Transparent string hash.  Gives the same value as std::hash<std::string>
+// so a HashTable<std::string, V, Prober, StringHash, std::equal_to<> > can
+// be searched with a std::string_view or string literal without building
+// a temporary std::string.  Needs C++17 for std::string_view.
+struct StringHash {
+    typedef void is_transparent;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+};
+#endif
+
+// Snapshot of a table's performance counters, returned by HashTable::stats()
+struct HashTableStats {
+    static constexpr size_t HISTOGRAM_SIZE = 32;
+    size_t totalProbes;     // slots examined by all probe sequences
+    size_t tombstones;      // deleted slots not yet reclaimed
+    size_t maxProbeLength;  // longest single probe sequence
+    size_t resizes;         // number of rehashes into a larger table
+    size_t compactions;     // same-capacity rehashes that purged tombstones
+    double rehashSeconds;   // wall time spent rehashing
+    // probeHistogram[i] counts probe sequences of length i+1; the last
+    // bucket also collects every longer sequence
+    size_t probeHistogram[HISTOGRAM_SIZE];
+};
+
+// Stats policies, selected through HashTable's Stats template parameter.
+// NoStats compiles every hook away, so only the always-on totalProbes and
+// tombstone counts are reported.
+struct NoStats {
+    void recordProbe(HASH_INDEX_T) {}
+    void recordResize() {}
+    void recordCompaction() {}
+    void beginRehash() {}
+    void endRehash() {}
+    void clear() {}
+    void report(HashTableStats&) const {}
+};
+
+// Records a probe-length histogram and resize count/duration
+struct ProbeStats {
+    ProbeStats() { clear(); }
+    void recordProbe(HASH_INDEX_T probes)
+    {
+        if(probes == 0) {
+            return;
+        }
+        // no std::min: it would bind a reference to HISTOGRAM_SIZE, which
+        // before C++17 needs a definition outside the class
+        HASH_INDEX_T bucket = (probes < HashTableStats::HISTOGRAM_SIZE) ? probes : HashTableStats::HISTOGRAM_SIZE;
+        histogram_[bucket - 1]++;
+        maxProbe_ = std::max<size_t>(maxProbe_, probes);
+    }
+    void recordResize() { resizes_++; }
+    void recordCompaction() { compactions_++; }
+    // Brackets each batch of rehash work, which for an incremental resize
+    // is spread over many operations
+    void beginRehash() { rehashStart_ = std::chrono::steady_clock::now(); }
+    void endRehash() { rehashTime_ += std::chrono::steady_clock::now() - rehashStart_; }
+    void clear()
+    {
+        std::fill(histogram_, histogram_ + HashTableStats::HISTOGRAM_SIZE, 0);
+        maxProbe_ = 0;
+        resizes_ = 0;
+        compactions_ = 0;
+        rehashTime_ = std::chrono::steady_clock::duration::zero();
+    }
+    void report(HashTableStats& s) const
+    {
+        std::copy(histogram_, histogram_ + HashTableStats::HISTOGRAM_SIZE, s.probeHistogram);
+        s.maxProbeLength = maxProbe_;
+        s.resizes = resizes_;
+        s.compactions = compactions_;
+        s.rehashSeconds = std::chrono::duration<double>(rehashTime_).count();
     }
+
+    size_t histogram_[HashTableStats::HISTOGRAM_SIZE];
+    size_t maxProbe_;
+    size_t resizes_;
+    size_t compactions_;
+    std::chrono::steady_clock::duration rehashTime_;
+    std::chrono::steady_clock::time_point rehashStart_;
 };
 
 
@@ -63,7 +442,8 @@ template<
     typename V, 
     typename Prober = LinearProber,
     typename Hash = std::hash<K>, 
-    typename KEqual = std::equal_to<K> >
+    typename KEqual = std::equal_to<K>,
+    typename Stats = NoStats >
 class HashTable
 {
 public:
@@ -71,14 +451,98 @@ public:
     typedef V ValueType;
     typedef std::pair<KeyType, ValueType> ItemType;
     typedef Hash Hasher;
-    struct HashItem {
-        ItemType item;
-        bool deleted;
-        HashItem(const ItemType& newItem){
-            item = newItem;
-            deleted = false;
+    // Uninitialized storage for one item; an item is only constructed in
+    // a slot while that slot's control byte is full
+    struct Slot {
+        alignas(ItemType) unsigned char bytes[sizeof(ItemType)];
+#if defined(__cpp_lib_launder)
+        ItemType* item() { return std::launder(reinterpret_cast<ItemType*>(bytes)); }
+        const ItemType* item() const { return std::launder(reinterpret_cast<const ItemType*>(bytes)); }
+#else
+        ItemType* item() { return reinterpret_cast<ItemType*>(bytes); }
+        const ItemType* item() const { return reinterpret_cast<const ItemType*>(bytes); }
+#endif
+    };
+
+    /**
+     * @brief Forward iterator over the items of the table, in slot order.
+     * Empty and deleted slots are skipped a control group at a time.  While
+     * an incremental resize is active the items still in the old table
+     * are visited after those of the current table.
+     * 
+     * Any insert, remove or non-const find invalidates all iterators.
+     */
+    template<bool IsConst>
+    class Iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef ItemType value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<IsConst, const ItemType*, ItemType*>::type pointer;
+        typedef typename std::conditional<IsConst, const ItemType&, ItemType&>::type reference;
+
+        Iterator() : ht_(nullptr), old_(false), idx_(npos) {}
+        // An iterator converts to a const_iterator
+        operator Iterator<true>() const { return Iterator<true>(ht_, old_, idx_); }
+
+        reference operator*() const { return *operator->(); }
+        pointer operator->() const
+        {
+            return old_ ? ht_->oldTable_[idx_].item() : ht_->table_[idx_].item();
+        }
+        Iterator& operator++()
+        {
+            idx_++;
+            settle();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator it(*this);
+            ++*this;
+            return it;
+        }
+        bool operator==(const Iterator& other) const
+        {
+            return idx_ == other.idx_ && old_ == other.old_ && ht_ == other.ht_;
+        }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class HashTable;
+        typedef typename std::conditional<IsConst, const HashTable*, HashTable*>::type Owner;
+        Iterator(Owner ht, bool old, HASH_INDEX_T idx) : ht_(ht), old_(old), idx_(idx) {}
+
+        // Moves forward from idx_ to the next full slot, or to end()
+        void settle()
+        {
+            if(!old_) {
+                HASH_INDEX_T m = capacity(ht_->mIndex_);
+                idx_ = nextFull(ht_->ctrl_, m, idx_);
+                if(idx_ != m) {
+                    return;
+                }
+                if(ht_->oldTable_ == nullptr) {
+                    idx_ = npos;
+                    return;
+                }
+                old_ = true;
+                idx_ = 0;
+            }
+            HASH_INDEX_T oldM = capacity(ht_->oldMIndex_);
+            idx_ = nextFull(ht_->oldCtrl_, oldM, idx_);
+            if(idx_ == oldM) {
+                old_ = false;
+                idx_ = npos;
+            }
         }
+
+        Owner ht_;
+        bool old_;          // true while visiting the old table
+        HASH_INDEX_T idx_;  // slot index, npos at end()
     };
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
 
     /**
      * @brief Construct a new Hash Table object
@@ -87,6 +551,9 @@ public:
      * @param prober Probing object of type Prober
      * @param hash Hash functor that supports hash(key) and returns a HASH_INDEX_T
      * @param kequal Functor that checks equality of two KeyType objects
+     *
+     * Instantiate with Stats = ProbeStats to record the probe-length
+     * histogram and resize timings reported by stats().
      */
     HashTable(
         double resizeAlpha = 0.4, 
@@ -94,6 +561,19 @@ public:
         const Hasher& hash = Hasher(), 
         const KEqual& kequal = KEqual());
 
+    /**
+     * @brief Construct a Hash Table holding the items in [first, last),
+     *        built as by bulk_insert
+     */
+    template<typename InputIt>
+    HashTable(
+        InputIt first,
+        InputIt last,
+        double resizeAlpha = 0.4, 
+        const Prober& prober = Prober(),
+        const Hasher& hash = Hasher(), 
+        const KEqual& kequal = KEqual());
+
     /**
      * @brief Destroy the Hash Table object and delete all remaining
      *         key,value pairs
@@ -101,6 +581,12 @@ public:
      */
     ~HashTable();
 
+    HashTable(const HashTable& other);
+    // Leaves other an empty table, which allocates again on its first insert
+    HashTable(HashTable&& other) noexcept;
+    HashTable& operator=(HashTable other) noexcept;
+    void swap(HashTable& other) noexcept;
+
     /**
      * @brief Returns true if the table has no non-deleted key,value pairs,
      *        and false otherwise
@@ -124,6 +610,42 @@ public:
      * @throw std::logic_error If no free location can be found
      */
     void insert(const ItemType& p);
+    void insert(ItemType&& p);
+
+    /**
+     * @brief Constructs an item from args and inserts it if its key is
+     *        not already present.  An existing item is left unchanged.
+     * 
+     * @return The item with the key, and true if it was inserted
+     * @throw std::logic_error If no free location can be found
+     */
+    template<typename... Args>
+    std::pair<ItemType*, bool> emplace(Args&&... args);
+
+    /**
+     * @brief Inserts (key, ValueType(args...)) if key is not present.
+     *        Unlike emplace, neither the key nor args are consumed and
+     *        no item is built when the key already exists.
+     * 
+     * @return The item with the key, and true if it was inserted
+     * @throw std::logic_error If no free location can be found
+     */
+    template<typename... Args>
+    std::pair<ItemType*, bool> try_emplace(const KeyType& key, Args&&... args);
+    template<typename... Args>
+    std::pair<ItemType*, bool> try_emplace(KeyType&& key, Args&&... args);
+
+    /**
+     * @brief Inserts (key, value), or assigns value to the existing item
+     *        with the given key (the behavior of insert)
+     * 
+     * @return The item with the key, and true if it was inserted
+     * @throw std::logic_error If no free location can be found
+     */
+    template<typename M>
+    std::pair<ItemType*, bool> insert_or_assign(const KeyType& key, M&& value);
+    template<typename M>
+    std::pair<ItemType*, bool> insert_or_assign(KeyType&& key, M&& value);
 
     /**
      * @brief Removes (marks as deleted) the item with the given key.  
@@ -135,7 +657,8 @@ public:
 
     /**
      * @brief Finds an item with the given key and returns a pointer 
-     * to the key,value pair
+     * to the key,value pair.  The const overload writes nothing, not even
+     * the probe counters, so it may run on several threads at once.
      * 
      * @param key 
      * @return ItemType const* nullptr is returned if the key does not exist
@@ -143,6 +666,147 @@ public:
     ItemType const * find(const KeyType& key) const;
     ItemType * find(const KeyType& key);
 
+    /**
+     * @brief Heterogeneous find, available when both Hash and KEqual are
+     * transparent (e.g. StringHash and std::equal_to<>), so a
+     * std::string_view can be looked up without converting it to KeyType
+     */
+    template<typename Q, typename H = Hash, typename E = KEqual, typename = typename
+        std::enable_if<IsTransparent<H>::value && IsTransparent<E>::value>::type>
+    ItemType const * find(const Q& key) const { return this->internalFind(key); }
+    template<typename Q, typename H = Hash, typename E = KEqual, typename = typename
+        std::enable_if<IsTransparent<H>::value && IsTransparent<E>::value>::type>
+    ItemType * find(const Q& key)
+    {
+        if(oldTable_ != nullptr) {
+            migrate(drainStep());
+        }
+        return this->internalFind(key);
+    }
+
+    /**
+     * @brief Variant of find() const that takes the hash and reports how
+     * many slots were examined.  Like every const lookup it writes nothing,
+     * so any number of threads may call it concurrently while no thread
+     * modifies the table.
+     * 
+     * @param key 
+     * @param hash Must equal Hasher()(key); lets callers that already
+     * hashed the key (e.g. to pick a shard) avoid hashing it again
+     * @param probes Receives the number of slots examined
+     * @return ItemType const* nullptr is returned if the key does not exist
+     */
+    ItemType const * lookup(const KeyType& key, HASH_INDEX_T hash, size_t& probes) const;
+
+    /**
+     * @brief Looks up n keys at once.  All keys of a batch are hashed and
+     * their home slots prefetched before any probe runs, so the memory
+     * latency of the lookups overlaps instead of being paid one at a time.
+     * 
+     * @param keys Array of n keys
+     * @param n Number of keys
+     * @param results Array of n pointers; results[i] receives what
+     * find(keys[i]) would return
+     */
+    void find_batch(const KeyType* keys, size_t n, ItemType const ** results) const;
+    void find_batch(const KeyType* keys, size_t n, ItemType ** results);
+
+    /**
+     * @brief Inserts n items, with the same effect as calling insert on
+     * each in order, hashing and prefetching them a batch at a time
+     * 
+     * @param items Array of n items
+     * @param n Number of items
+     * @throw std::logic_error If no free location can be found
+     */
+    void insert_batch(const ItemType* items, size_t n);
+
+    /**
+     * @brief Writes an image of the table to path that open_mapped() can
+     * serve lookups from directly.  Requires trivially copyable keys and
+     * values.  Finishes any incremental resize first.
+     * 
+     * @throw std::runtime_error If the file cannot be written
+     */
+    void save(const std::string& path);
+
+    /**
+     * @brief Maps an image written by save() and returns a table whose
+     * lookups read the mapping in place, with no deserialisation.  Pages
+     * are shared by every process that maps the file until the table is
+     * modified; the first insert or remove copies it to private memory.
+     * 
+     * The image must have been written with the same Prober and a hash
+     * that gives the same values (checked through seed() if Hash has one).
+     * Key, value, Prober and Hash types are checked by name, so images are
+     * only portable between builds made with the same compiler.
+     * 
+     * @throw std::runtime_error If the file is missing, is not a snapshot,
+     * or was written for a different key, value, Prober or Hash type,
+     * capacity policy or seed
+     */
+    static HashTable open_mapped(
+        const std::string& path,
+        double resizeAlpha = 0.4, 
+        const Prober& prober = Prober(),
+        const Hasher& hash = Hasher(), 
+        const KEqual& kequal = KEqual());
+
+    // True if the table still reads a mapping made by open_mapped()
+    bool mapped() const { return mapping_ != nullptr; }
+
+    /**
+     * @brief Grows the table, if needed, straight to the smallest
+     * capacity that holds n items below the resize threshold, so that
+     * inserting up to n items triggers no further resize.  Never shrinks.
+     * 
+     * @param n Number of items to make room for
+     * @throw std::logic_error If no capacity is large enough
+     */
+    void reserve(size_t n);
+
+    /**
+     * @brief Inserts the items in [first, last), with the same effect as
+     * calling insert on each in order.  For forward iterators the table is
+     * sized once up front with reserve() and the items are then placed
+     * without any per-item load factor check.
+     * 
+     * @throw std::logic_error If no free location can be found
+     */
+    template<typename InputIt>
+    void bulk_insert(InputIt first, InputIt last);
+
+    /**
+     * @brief Selects how a resize rehashes.  With 0 (the default) every
+     * item is moved to the new table in one call.  Otherwise the old
+     * table is kept beside the new one and each insert, remove and
+     * non-const find migrates up to bucketsPerOp old slots until it
+     * drains, bounding the latency of any single call.
+     *
+     * The old table must be empty before the next resize, or that resize
+     * would have to drain the rest at once.  A resize leaves about
+     * rAlpha * (newM - oldM) inserts before the next one, so a step below
+     * oldM / (rAlpha * (newM - oldM)) (3 for the default rAlpha of 0.4 and
+     * capacities that double) is raised to that while draining; the step
+     * actually used spreads the old slots left over the inserts left.
+     *
+     * In this mode remove() and insert purge tombstones the same way, by
+     * migrating into a fresh table of the same capacity, instead of with
+     * one O(m) in-place rehash.  Like a resize, that holds both tables in
+     * memory until the old one drains.
+     * 
+     * @param bucketsPerOp Old slots migrated per operation
+     */
+    void setIncrementalResize(size_t bucketsPerOp);
+
+    /**
+     * @brief Sets the fraction of the table's capacity that tombstones
+     * may occupy before remove() purges them with a same-capacity rehash.
+     * 
+     * @param fraction Tombstone limit as a fraction of capacity (default 0.2)
+     */
+    void setTombstoneLimit(double fraction);
+
     /**
      * @brief Returns the value corresponding to the given key
      * 
@@ -158,73 +822,307 @@ public:
     // Debug / Performance functions
     void reportAll(std::ostream& out) const;
     void clearTotalProbes() { totalProbes_ = 0; }
+    // Probes made by inserts, removes and non-const lookups; const lookups
+    // write nothing, so they are not counted (see lookup())
     size_t totalProbes() const { return totalProbes_; }
+    // Slots in the current table (excluding one still being migrated)
+    size_t bucket_count() const { return capacity(mIndex_); }
+
+    /**
+     * @brief Returns the current performance counters.  Fields other than
+     * totalProbes and tombstones stay zero unless Stats records them.
+     */
+    HashTableStats stats() const;
+
+    /**
+     * @brief Resets totalProbes and everything recorded by Stats
+     */
+    void clearStats();
+
+    // Iteration in slot order; see Iterator
+    iterator begin() { iterator it(this, false, 0); it.settle(); return it; }
+    iterator end() { return iterator(this, false, npos); }
+    const_iterator begin() const { const_iterator it(this, false, 0); it.settle(); return it; }
+    const_iterator end() const { return const_iterator(this, false, npos); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    /**
+     * @brief Calls f on every item in chunk number `chunk` of `chunks`
+     * equal, disjoint slot ranges (taken from both tables during an
+     * incremental resize).  Calls for different chunks touch different
+     * items, so each of `chunks` threads may run one of them at the same
+     * time provided nothing modifies the table meanwhile.
+     * 
+     * @param chunk Index of the chunk to visit, in [0, chunks)
+     * @param chunks Number of chunks the table is split into
+     * @param f Called as f(ItemType&), or f(const ItemType&) when const
+     * @throw std::invalid_argument If chunk is not below chunks (so also
+     * if chunks is 0)
+     */
+    template<typename F>
+    void for_each_chunk(size_t chunk, size_t chunks, F f);
+    template<typename F>
+    void for_each_chunk(size_t chunk, size_t chunks, F f) const;
+
+    /**
+     * @brief Removes every item for which pred(const ItemType&) is true
+     * in a single pass over the slots, purging the tombstones afterwards
+     * if they exceed the tombstone limit
+     * 
+     * @return The number of items removed
+     */
+    template<typename Pred>
+    size_t erase_if(Pred pred);
 private:
+    // Returns the first full slot in [i, m), or m if there is none
+    static HASH_INDEX_T nextFull(const CTRL_T* ctrl, HASH_INDEX_T m, HASH_INDEX_T i);
+    // Calls f(item) on the full slots of [lo, hi) of one table
+    template<typename Item, typename F>
+    static void visitRange(Item* table, const CTRL_T* ctrl, HASH_INDEX_T m,
+        HASH_INDEX_T lo, HASH_INDEX_T hi, F& f);
     /**
-     * @brief Helper routine to find a given key
+     * @brief Helper routine to find a given key.  The non-const overloads
+     * record their probes; the const ones write nothing, so const lookups
+     * are safe to run concurrently and are not counted.
      * 
      * @param key 
-     * @return HashItem* returns nullptr if key does not exist
+     * @return ItemType* returns nullptr if key does not exist
      */
-    HashItem * internalFind(const KeyType& key) const;
+    template<typename Q>
+    ItemType * internalFind(const Q& key) { return internalFind(key, hash_(key)); }
+    template<typename Q>
+    ItemType * internalFind(const Q& key, HASH_INDEX_T hash)
+    {
+        HASH_INDEX_T probes;
+        ItemType * item = internalFind(key, hash, probes);
+        recordProbe(probes);
+        return item;
+    }
+    template<typename Q>
+    ItemType * internalFind(const Q& key) const
+    {
+        HASH_INDEX_T probes;
+        return internalFind(key, hash_(key), probes);
+    }
+    // Reports the probe count instead of recording it
+    template<typename Q>
+    ItemType * internalFind(const Q& key, HASH_INDEX_T hash, HASH_INDEX_T& probes) const;
+    // Prefetches the home slot of each hash in the current table
+    void prefetchHome(const HASH_INDEX_T* hashes, size_t n) const;
     /**
      * @brief Performs the probing sequence and returns the index
      * of the table location with the given key or the location where
-     * key can be inserted (i.e. the index now contains nullptr) but is
+     * key can be inserted (i.e. the control byte is empty) but is
      * available.
      * 
      * @param key 
+     * @param hash hash_(key), computed once by the caller
      * @return returns npos is the key does not exist and
      * no free location is available
      */
-    HASH_INDEX_T probe(const KeyType& key) const;
+    template<typename Q>
+    HASH_INDEX_T probe(const Q& key, HASH_INDEX_T hash)
+    {
+        return probe(table_, ctrl_, mIndex_, key, hash);
+    }
+    template<typename Q>
+    HASH_INDEX_T probe(const Slot* table, const CTRL_T* ctrl, HASH_INDEX_T mIndex,
+        const Q& key, HASH_INDEX_T hash)
+    {
+        HASH_INDEX_T probes;
+        HASH_INDEX_T loc = probe(table, ctrl, mIndex, key, hash, probes);
+        recordProbe(probes);
+        return loc;
+    }
+    // Same as above but reports the probe count instead of recording it
+    template<typename Q>
+    HASH_INDEX_T probe(const Slot* table, const CTRL_T* ctrl, HASH_INDEX_T mIndex,
+        const Q& key, HASH_INDEX_T hash, HASH_INDEX_T& probes) const;
+
+    /**
+     * @brief Returns the first empty or deleted location in the probe
+     * sequence for hash.  Used when the key is known to be absent.
+     */
+    HASH_INDEX_T probeFree(HASH_INDEX_T hash) const;
+
+    // 7-bit tag stored in the control byte of a full slot
+    static CTRL_T tagOf(HASH_INDEX_T hash) { return (CTRL_T)((hash ^ (hash >> 7) ^ (hash >> 57)) & 0x7F); }
+    // Accounts for one completed probe sequence of the given length
+    void recordProbe(HASH_INDEX_T probes)
+    {
+        totalProbes_ += probes;
+        stats_.recordProbe(probes);
+    }
+    // Sets a control byte and its mirror in the cloned tail
+    static void setCtrl(CTRL_T* ctrl, HASH_INDEX_T m, HASH_INDEX_T loc, CTRL_T c);
+    void setCtrl(HASH_INDEX_T loc, CTRL_T c) { setCtrl(ctrl_, capacity(mIndex_), loc, c); }
+    // Allocates empty slot and control arrays of size m
+    static void allocate(HASH_INDEX_T m, Slot*& table, CTRL_T*& ctrl);
+    // Allocates copies of another table's slot and control arrays
+    static void copy(HASH_INDEX_T m, const Slot* srcTable, const CTRL_T* srcCtrl,
+        Slot*& table, CTRL_T*& ctrl);
+    // Destroys the items of a table and frees its slot and control arrays
+    static void destroy(HASH_INDEX_T m, Slot* table, CTRL_T* ctrl);
+    // Frees the current table and any table still being migrated
+    void release();
+    // Gives a table that was moved from (table_ == nullptr) storage of its
+    // own, and replaces one mapped by open_mapped() with a private copy.
+    // Every mutation calls this before writing to the table.
+    void detach();
+    // All-empty control bytes for capacity(0), shared by every table that
+    // was moved from; never written, since detach() replaces them first
+    static CTRL_T* sharedEmptyCtrl()
+    {
+        static std::vector<CTRL_T> ctrl(capacity(0) + GROUP_WIDTH - 1, CTRL_EMPTY);
+        return ctrl.data();
+    }
+
+    // On-disk image header; control bytes follow it and the slot array
+    // starts at slotOffset, aligned for Slot
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t itemSize;
+        uint64_t itemAlign;
+        uint64_t keySize;
+        uint64_t valueSize;
+        uint64_t keyType;       // typeFingerprint() of K, V, Prober and Hash
+        uint64_t valueType;
+        uint64_t proberType;
+        uint64_t hashType;
+        uint64_t groupWidth;
+        uint64_t capacity;
+        uint64_t mIndex;
+        uint64_t size;
+        uint64_t loadingCnt;
+        uint64_t hashSeed;
+        uint64_t slotOffset;
+    };
+    static const uint32_t SNAPSHOT_VERSION = 3;
+    static uint64_t snapshotSlotOffset(HASH_INDEX_T m)
+    {
+        uint64_t align = std::max<uint64_t>(alignof(Slot), 64);
+        return (sizeof(SnapshotHeader) + m + GROUP_WIDTH - 1 + align - 1) / align * align;
+    }
+    /**
+     * @brief Common first half of every insertion: advances any
+     * incremental resize, grows or compacts the table if needed, then
+     * looks for key in both tables.
+     * 
+     * @return The existing item with the key, or nullptr and the slot
+     * where a new item with that key should be constructed
+     * @throw std::logic_error If no free location can be found
+     */
+    std::pair<ItemType*, HASH_INDEX_T> prepareInsert(const KeyType& key, HASH_INDEX_T hash);
+    // Second half of prepareInsert, for callers that have already made room
+    template<typename Q>
+    std::pair<ItemType*, HASH_INDEX_T> findOrFree(const Q& key, HASH_INDEX_T hash);
+    // Constructs a new item in slot idx returned by prepareInsert
+    template<typename... Args>
+    ItemType* constructAt(HASH_INDEX_T idx, HASH_INDEX_T hash, Args&&... args);
+    // As constructAt, but leaves size_ to the caller
+    template<typename... Args>
+    ItemType* placeAt(HASH_INDEX_T idx, HASH_INDEX_T hash, Args&&... args);
+    /**
+     * @brief For Robin Hood probers, makes room for a new item whose probe
+     * sequence first reaches a free slot at idx by shifting the run after
+     * the item's rightful position along by one.  
+     * 
+     * @return The slot the new item should occupy; idx for other probers
+     */
+    HASH_INDEX_T makeRoom(HASH_INDEX_T idx, HASH_INDEX_T hash);
+    template<typename KArg, typename... Args>
+    std::pair<ItemType*, bool> tryEmplaceImpl(KArg&& key, Args&&... args);
+    template<typename KArg, typename M>
+    std::pair<ItemType*, bool> insertOrAssignImpl(KArg&& key, M&& value);
+
+    // Moves an item known to be absent into the current table
+    void moveIn(ItemType* item);
+    // Migrates up to buckets slots of the old table, freeing it once drained
+    void migrate(HASH_INDEX_T buckets);
+    // Number of tombstones in the current table
+    size_t tombstones() const { return loadingCnt_ - (size_ - oldSize_); }
+
+    /**
+     * @brief Rehashes the current table in place at the same capacity,
+     * turning every tombstone back into an empty slot.  Runs in O(m) and
+     * allocates nothing.  Not used while an incremental resize is active.
+     */
+    void rehashInPlace();
 
     // Constant to signify an invalid hash location is being returned
     static const HASH_INDEX_T npos = Prober::npos;
 
     /**
      * @brief Resizes the hash table replacing the old with a new
-     * table of the next prime size given in CAPACITIES.  Must rehash
+     * table of the next size given by Capacity.  Must rehash
      * all non-deleted items while freeing all deleted items.
      * 
-     * Must run in O(m) where m is the new table size
+     * Must run in O(m) where m is the new table size.  In incremental
+     * mode the rehash is spread over later operations instead, and any
+     * migration still in progress is finished first.
      * 
-     * @throws std::logic_error if no more CAPACITIES exist
+     * @throws std::logic_error if no larger capacity exists
      */
-    void resize();
+    void resize() { resize(mIndex_ + 1); }
+    // Old slots migrated per operation while a resize is under way:
+    // migrateStep_, raised if needed so that the old table drains before
+    // the new one fills up to rAlpha_
+    HASH_INDEX_T drainStep() const;
+    // Drops every tombstone: with rehashInPlace() at once, or when resizing
+    // incrementally by migrating into a fresh table of the same capacity
+    void purgeTombstones();
+    // Resizes to the given capacity index, skipping any in between
+    void resize(HASH_INDEX_T newMIndex);
 
     // Data members
-    std::vector<HashItem*> table_; // actual hash table
+    Slot* table_;   // actual hash table, items stored inline
+    // control byte per slot, followed by GROUP_WIDTH-1 bytes mirroring the
+    // start of the table so a group scan never has to wrap
+    CTRL_T* ctrl_;
     Hasher hash_;   
     KEqual kequal_;
-    mutable Prober prober_;  // mutable allows const member functions to modify this member
+    // Probing prototype; each probe sequence runs on its own copy so that
+    // const member functions stay free of writes to shared state
+    Prober prober_;
     // debug/performance counters
-    mutable size_t totalProbes_; // mutable allows const member functions to modify this member
-    // prime capacities to be used when resizing/rehashing is needed
-    static const HASH_INDEX_T CAPACITIES[];
+    // only non-const members update them, so const lookups write nothing
+    size_t totalProbes_;
+    Stats stats_;
+    // capacities to be used when resizing/rehashing is needed
+    typedef typename Prober::Capacity Capacity;
+    static HASH_INDEX_T capacity(HASH_INDEX_T mIndex) { return Capacity::size(mIndex); }
     HASH_INDEX_T mIndex_;  // index to CAPACITIES
 
     // ADD MORE DATA MEMBERS HERE, AS NECESSARY
     double rAlpha_;
     size_t size_;
     size_t loadingCnt_; // AK: added
+
+    // Incremental resize state; oldTable_ is nullptr unless a previous
+    // table is still being drained into table_
+    Slot* oldTable_;
+    CTRL_T* oldCtrl_;
+    HASH_INDEX_T oldMIndex_;
+    HASH_INDEX_T migrateIdx_;  // next old slot to migrate
+    size_t oldSize_;           // live items left in the old table
+    size_t migrateStep_;       // old slots migrated per operation, 0 = all at once
+    double tombAlpha_;         // tombstone fraction that triggers rehashInPlace()
+
+    // Mapping that table_ and ctrl_ point into, or nullptr if they are
+    // owned allocations
+    void* mapping_;
+    size_t mappingSize_;
 };
 
 // ----------------------------------------------------------------------------
 //                           Hash Table Implementation
 // ----------------------------------------------------------------------------
 
-// Static array of prime table sizes
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-const HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual>::CAPACITIES[] =
-    {
-        11, 23, 47, 97, 197, 397, 797, 1597, 3203, 6421, 12853, 25717, 51437, 102877,
-        205759, 411527, 823117, 1646237, 3292489, 6584983, 13169977, 26339969, 52679969,
-        105359969, 210719881, 421439783, 842879579, 1685759167
-    };
-
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-HashTable<K,V,Prober,Hash,KEqual>::HashTable(
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::HashTable(
     double resizeAlpha, const Prober& prober, const Hasher& hash, const KEqual& kequal)
        :  hash_(hash), kequal_(kequal), prober_(prober), rAlpha_(resizeAlpha)
 {
@@ -232,194 +1130,1189 @@ HashTable<K,V,Prober,Hash,KEqual>::HashTable(
     totalProbes_ = 0;
     // Initialize any other data members as necessary
     size_ = 0;
-    table_.resize(CAPACITIES[mIndex_]);
     loadingCnt_ = 0;
+    allocate(capacity(mIndex_), table_, ctrl_);
+    oldTable_ = nullptr;
+    oldCtrl_ = nullptr;
+    oldMIndex_ = 0;
+    migrateIdx_ = 0;
+    oldSize_ = 0;
+    migrateStep_ = 0;
+    tombAlpha_ = 0.2;
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    // set up now so that moving from this table cannot throw
+    sharedEmptyCtrl();
+}
 
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename InputIt>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::HashTable(InputIt first, InputIt last,
+    double resizeAlpha, const Prober& prober, const Hasher& hash, const KEqual& kequal)
+       :  HashTable(resizeAlpha, prober, hash, kequal)
+{
+    bulk_insert(first, last);
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-HashTable<K,V,Prober,Hash,KEqual>::~HashTable()
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::~HashTable()
 {
-    for(HASH_INDEX_T i = 0; i < CAPACITIES[mIndex_]; ++i) {
-        if(table_[i] != nullptr) {
-           delete table_[i];
+    release();
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::HashTable(const HashTable& other)
+       :  hash_(other.hash_), kequal_(other.kequal_), prober_(other.prober_),
+          totalProbes_(other.totalProbes_), stats_(other.stats_), mIndex_(other.mIndex_),
+          rAlpha_(other.rAlpha_), size_(other.size_), loadingCnt_(other.loadingCnt_),
+          oldTable_(nullptr), oldCtrl_(nullptr), oldMIndex_(other.oldMIndex_),
+          migrateIdx_(other.migrateIdx_), oldSize_(other.oldSize_), migrateStep_(other.migrateStep_),
+          tombAlpha_(other.tombAlpha_), mapping_(nullptr), mappingSize_(0)
+{
+    copy(capacity(mIndex_), other.table_, other.ctrl_, table_, ctrl_);
+    if(other.oldTable_ != nullptr) {
+        try {
+            copy(capacity(oldMIndex_), other.oldTable_, other.oldCtrl_, oldTable_, oldCtrl_);
+        }
+        catch(...) {
+            destroy(capacity(mIndex_), table_, ctrl_);
+            throw;
         }
     }
+}
 
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::HashTable(HashTable&& other) noexcept
+       :  hash_(std::move(other.hash_)), kequal_(std::move(other.kequal_)), prober_(other.prober_),
+          totalProbes_(other.totalProbes_), stats_(other.stats_), mIndex_(other.mIndex_),
+          rAlpha_(other.rAlpha_), size_(other.size_), loadingCnt_(other.loadingCnt_),
+          oldTable_(other.oldTable_), oldCtrl_(other.oldCtrl_), oldMIndex_(other.oldMIndex_),
+          migrateIdx_(other.migrateIdx_), oldSize_(other.oldSize_), migrateStep_(other.migrateStep_),
+          tombAlpha_(other.tombAlpha_), mapping_(other.mapping_), mappingSize_(other.mappingSize_)
+{
+    table_ = other.table_;
+    ctrl_ = other.ctrl_;
+    other.table_ = nullptr;
+    other.ctrl_ = sharedEmptyCtrl();
+    other.mIndex_ = 0;
+    other.oldTable_ = nullptr;
+    other.oldCtrl_ = nullptr;
+    other.mapping_ = nullptr;
+    other.mappingSize_ = 0;
+    other.size_ = 0;
+    other.loadingCnt_ = 0;
+    other.oldSize_ = 0;
+    other.migrateIdx_ = 0;
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-bool HashTable<K,V,Prober,Hash,KEqual>::empty() const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTable<K,V,Prober,Hash,KEqual,Stats>& HashTable<K,V,Prober,Hash,KEqual,Stats>::operator=(HashTable other) noexcept
+{
+    swap(other);
+    return *this;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::swap(HashTable& other) noexcept
+{
+    std::swap(table_, other.table_);
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(hash_, other.hash_);
+    std::swap(kequal_, other.kequal_);
+    std::swap(prober_, other.prober_);
+    std::swap(totalProbes_, other.totalProbes_);
+    std::swap(stats_, other.stats_);
+    std::swap(mIndex_, other.mIndex_);
+    std::swap(rAlpha_, other.rAlpha_);
+    std::swap(size_, other.size_);
+    std::swap(loadingCnt_, other.loadingCnt_);
+    std::swap(oldTable_, other.oldTable_);
+    std::swap(oldCtrl_, other.oldCtrl_);
+    std::swap(oldMIndex_, other.oldMIndex_);
+    std::swap(migrateIdx_, other.migrateIdx_);
+    std::swap(oldSize_, other.oldSize_);
+    std::swap(migrateStep_, other.migrateStep_);
+    std::swap(tombAlpha_, other.tombAlpha_);
+    std::swap(mapping_, other.mapping_);
+    std::swap(mappingSize_, other.mappingSize_);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::allocate(HASH_INDEX_T m, Slot*& table, CTRL_T*& ctrl)
+{
+    table = new Slot[m];
+    try {
+        ctrl = new CTRL_T[m + GROUP_WIDTH - 1];
+    }
+    catch(...) {
+        delete [] table;
+        throw;
+    }
+    std::memset(ctrl, CTRL_EMPTY, m + GROUP_WIDTH - 1);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::copy(HASH_INDEX_T m,
+    const Slot* srcTable, const CTRL_T* srcCtrl, Slot*& table, CTRL_T*& ctrl)
+{
+    allocate(m, table, ctrl);
+    HASH_INDEX_T i = 0;
+    try {
+        for( ; i < m; ++i) {
+            if(srcCtrl[i] >= 0) {
+                new (table[i].bytes) ItemType(*srcTable[i].item());
+            }
+        }
+    }
+    catch(...) {
+        while(i-- > 0) {
+            if(srcCtrl[i] >= 0) {
+                table[i].item()->~ItemType();
+            }
+        }
+        delete [] table;
+        delete [] ctrl;
+        throw;
+    }
+    std::memcpy(ctrl, srcCtrl, m + GROUP_WIDTH - 1);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::destroy(HASH_INDEX_T m, Slot* table, CTRL_T* ctrl)
+{
+    for(HASH_INDEX_T i = 0; i < m; ++i) {
+        if(ctrl[i] >= 0) {
+            table[i].item()->~ItemType();
+        }
+    }
+    delete [] table;
+    delete [] ctrl;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::release()
+{
+    if(mapping_ != nullptr) {
+        // mapped items are trivially destructible; an incremental resize
+        // never starts before detach()
+#if defined(HT_HAVE_MMAP)
+        munmap(mapping_, mappingSize_);
+#endif
+        mapping_ = nullptr;
+        table_ = nullptr;
+        ctrl_ = nullptr;
+    }
+    if(table_ != nullptr) {
+        destroy(capacity(mIndex_), table_, ctrl_);
+        table_ = nullptr;
+        ctrl_ = nullptr;
+    }
+    if(oldTable_ != nullptr) {
+        destroy(capacity(oldMIndex_), oldTable_, oldCtrl_);
+        oldTable_ = nullptr;
+        oldCtrl_ = nullptr;
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::detach()
+{
+    if(table_ == nullptr) {
+        allocate(capacity(mIndex_), table_, ctrl_);
+        return;
+    }
+    // a compile-time constant; Slot is raw bytes, so the copy below compiles
+    // for every item type even where it can never run
+    if(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value) {
+        if(mapping_ == nullptr) {
+            return;
+        }
+        // only such items are ever mapped, so their bytes can be copied
+        HASH_INDEX_T m = capacity(mIndex_);
+        Slot* table;
+        CTRL_T* ctrl;
+        allocate(m, table, ctrl);
+        std::memcpy(table, table_, m * sizeof(Slot));
+        std::memcpy(ctrl, ctrl_, m + GROUP_WIDTH - 1);
+        release();
+        table_ = table;
+        ctrl_ = ctrl;
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::save(const std::string& path)
+{
+    // std::pair itself never is trivially copyable, but copying its bytes
+    // is sound when both members are
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+        "save() requires trivially copyable keys and values");
+    if(oldTable_ != nullptr) {
+        migrate(capacity(oldMIndex_));
+    }
+    HASH_INDEX_T m = capacity(mIndex_);
+    SnapshotHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, "HTSNAP\0\0", 8);
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.byteOrder = 0x01020304;
+    hdr.itemSize = sizeof(ItemType);
+    hdr.itemAlign = alignof(ItemType);
+    hdr.keySize = sizeof(K);
+    hdr.valueSize = sizeof(V);
+    hdr.keyType = typeFingerprint<K>();
+    hdr.valueType = typeFingerprint<V>();
+    hdr.proberType = typeFingerprint<Prober>();
+    hdr.hashType = typeFingerprint<Hash>();
+    hdr.groupWidth = GROUP_WIDTH;
+    hdr.capacity = m;
+    hdr.mIndex = mIndex_;
+    hdr.size = size_;
+    hdr.loadingCnt = loadingCnt_;
+    hdr.hashSeed = HasherSeed<Hasher>::get(hash_);
+    hdr.slotOffset = snapshotSlotOffset(m);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(ctrl_), m + GROUP_WIDTH - 1);
+    std::vector<char> pad(hdr.slotOffset - sizeof(hdr) - (m + GROUP_WIDTH - 1), 0);
+    out.write(pad.data(), pad.size());
+    // free slots hold indeterminate bytes; write zeros instead
+    Slot zero;
+    std::memset(zero.bytes, 0, sizeof(zero.bytes));
+    for(HASH_INDEX_T i = 0; i < m; ++i) {
+        const Slot& slot = (ctrl_[i] >= 0) ? table_[i] : zero;
+        out.write(reinterpret_cast<const char*>(slot.bytes), sizeof(Slot));
+    }
+    if(!out.flush()) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTable<K,V,Prober,Hash,KEqual,Stats> HashTable<K,V,Prober,Hash,KEqual,Stats>::open_mapped(
+    const std::string& path, double resizeAlpha, const Prober& prober, const Hasher& hash, const KEqual& kequal)
+{
+    // std::pair itself never is trivially copyable, but copying its bytes
+    // is sound when both members are
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+        "open_mapped() requires trivially copyable keys and values");
+#if defined(HT_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a hash table snapshot");
+    }
+    size_t len = st.st_size;
+    // private and writable so that values reached through find() may be
+    // updated; pages stay shared until one is actually written
+    void* base = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED) {
+        throw std::runtime_error("cannot map " + path);
+    }
+    SnapshotHeader hdr;
+    std::memcpy(&hdr, base, sizeof(hdr));
+    const char* problem = nullptr;
+    if(std::memcmp(hdr.magic, "HTSNAP\0\0", 8) != 0 || hdr.byteOrder != 0x01020304) {
+        problem = " is not a hash table snapshot";
+    }
+    else if(hdr.version != SNAPSHOT_VERSION) {
+        problem = " has an unsupported snapshot version";
+    }
+    else if(hdr.itemSize != sizeof(ItemType) || hdr.itemAlign != alignof(ItemType)
+            || hdr.keySize != sizeof(K) || hdr.valueSize != sizeof(V)
+            || hdr.keyType != typeFingerprint<K>() || hdr.valueType != typeFingerprint<V>()
+            || hdr.groupWidth != GROUP_WIDTH) {
+        problem = " was written for a different item type";
+    }
+    else if(hdr.proberType != typeFingerprint<Prober>()) {
+        problem = " was written with a different Prober";
+    }
+    else if(hdr.hashType != typeFingerprint<Hash>()) {
+        problem = " was written with a different hash function";
+    }
+    else if(hdr.mIndex >= Capacity::count || hdr.capacity != capacity(hdr.mIndex)
+            || hdr.slotOffset != snapshotSlotOffset(hdr.capacity)
+            || len < hdr.slotOffset + hdr.capacity * sizeof(Slot)) {
+        problem = " does not match this table's capacities";
+    }
+    else if(hdr.hashSeed != HasherSeed<Hasher>::get(hash)) {
+        problem = " was written with a different hash seed";
+    }
+    if(problem != nullptr) {
+        munmap(base, len);
+        throw std::runtime_error(path + problem);
+    }
+
+    HashTable t(resizeAlpha, prober, hash, kequal);
+    t.release();
+    t.mapping_ = base;
+    t.mappingSize_ = len;
+    t.ctrl_ = reinterpret_cast<CTRL_T*>(static_cast<char*>(base) + sizeof(SnapshotHeader));
+    t.table_ = reinterpret_cast<Slot*>(static_cast<char*>(base) + hdr.slotOffset);
+    t.mIndex_ = hdr.mIndex;
+    t.size_ = hdr.size;
+    t.loadingCnt_ = hdr.loadingCnt;
+    return t;
+#else
+    (void)path; (void)resizeAlpha; (void)prober; (void)hash; (void)kequal;
+    throw std::runtime_error("memory-mapped snapshots are not supported on this platform");
+#endif
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::setCtrl(CTRL_T* ctrl, HASH_INDEX_T m, HASH_INDEX_T loc, CTRL_T c)
+{
+    ctrl[loc] = c;
+    // tables smaller than a group are mirrored more than once
+    for(HASH_INDEX_T i = loc + m; i < m + GROUP_WIDTH - 1; i += m) {
+        ctrl[i] = c;
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+bool HashTable<K,V,Prober,Hash,KEqual,Stats>::empty() const
 {
     return (size_ == 0);
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-size_t HashTable<K,V,Prober,Hash,KEqual>::size() const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+size_t HashTable<K,V,Prober,Hash,KEqual,Stats>::size() const
 {
     return size_;
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-void HashTable<K,V,Prober,Hash,KEqual>::insert(const ItemType& p)
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::insert(const ItemType& p)
 {
-    std::cout << "--lf: " << (double)loadingCnt_/CAPACITIES[mIndex_] << " ";
-    std::cout << "lc " << loadingCnt_ << std::endl;
-    // std::cout << "count " << size_ << std::endl;
-    if ((double)loadingCnt_/CAPACITIES[mIndex_] >= rAlpha_) { // AK added
-        resize();
+    insertOrAssignImpl(p.first, p.second);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::insert(ItemType&& p)
+{
+    insertOrAssignImpl(std::move(p.first), std::move(p.second));
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename... Args>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::emplace(Args&&... args)
+{
+    // the key is only known once the item exists, so build it up front
+    // and move it into place
+    ItemType item(std::forward<Args>(args)...);
+    HASH_INDEX_T hash = hash_(item.first);
+    std::pair<ItemType*, HASH_INDEX_T> found = prepareInsert(item.first, hash);
+    if(found.first != nullptr) {
+        return std::make_pair(found.first, false);
     }
-    HASH_INDEX_T idx = probe(p.first);
+    return std::make_pair(constructAt(found.second, hash, std::move(item)), true);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename... Args>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::try_emplace(const KeyType& key, Args&&... args)
+{
+    return tryEmplaceImpl(key, std::forward<Args>(args)...);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename... Args>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::try_emplace(KeyType&& key, Args&&... args)
+{
+    return tryEmplaceImpl(std::move(key), std::forward<Args>(args)...);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename M>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::insert_or_assign(const KeyType& key, M&& value)
+{
+    return insertOrAssignImpl(key, std::forward<M>(value));
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename M>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::insert_or_assign(KeyType&& key, M&& value)
+{
+    return insertOrAssignImpl(std::move(key), std::forward<M>(value));
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename KArg, typename... Args>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::tryEmplaceImpl(KArg&& key, Args&&... args)
+{
+    HASH_INDEX_T hash = hash_(key);
+    std::pair<ItemType*, HASH_INDEX_T> found = prepareInsert(key, hash);
+    if(found.first != nullptr) {
+        return std::make_pair(found.first, false);
+    }
+    ItemType* item = constructAt(found.second, hash, std::piecewise_construct,
+        std::forward_as_tuple(std::forward<KArg>(key)),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(item, true);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename KArg, typename M>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, bool>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::insertOrAssignImpl(KArg&& key, M&& value)
+{
+    HASH_INDEX_T hash = hash_(key);
+    std::pair<ItemType*, HASH_INDEX_T> found = prepareInsert(key, hash);
+    if(found.first != nullptr) {
+        found.first->second = std::forward<M>(value);
+        return std::make_pair(found.first, false);
+    }
+    ItemType* item = constructAt(found.second, hash,
+        std::forward<KArg>(key), std::forward<M>(value));
+    return std::make_pair(item, true);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, HASH_INDEX_T>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::prepareInsert(const KeyType& key, HASH_INDEX_T hash)
+{
+    detach();
+    if (oldTable_ != nullptr) {
+        migrate(drainStep());
+    }
+    // items still in the old table will all land in the current one
+    if ((double)(loadingCnt_ + oldSize_)/capacity(mIndex_) >= rAlpha_) { // AK added
+        // growing would not help if most of the load is tombstones
+        if (oldTable_ == nullptr && (double)size_/capacity(mIndex_) < rAlpha_/2) {
+            purgeTombstones();
+        }
+        else {
+            resize();
+        }
+    }
+    return findOrFree(key, hash);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename Q>
+std::pair<typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*, HASH_INDEX_T>
+HashTable<K,V,Prober,Hash,KEqual,Stats>::findOrFree(const Q& key, HASH_INDEX_T hash)
+{
+    HASH_INDEX_T idx = probe(key, hash);
+    if (idx != npos && ctrl_[idx] >= 0) {
+        return std::make_pair(table_[idx].item(), idx);
+    }
+    if (oldTable_ != nullptr) {
+        HASH_INDEX_T oldIdx = probe(oldTable_, oldCtrl_, oldMIndex_, key, hash);
+        if (oldIdx != npos && oldCtrl_[oldIdx] >= 0) {
+            return std::make_pair(oldTable_[oldIdx].item(), oldIdx);
+        }
+    }
+    // The key is absent; reuse the first tombstone in its probe sequence
+    // if one comes before the empty slot that ended the search
+    idx = probeFree(hash);
     if (idx == npos) {
         throw std::logic_error("no free location");
     }
-    else if (table_[idx] == nullptr) {
-        table_[idx] = new HashItem(p); 
-        size_++;
+    return std::make_pair((ItemType*)nullptr, idx);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename... Args>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*
+HashTable<K,V,Prober,Hash,KEqual,Stats>::constructAt(HASH_INDEX_T idx, HASH_INDEX_T hash, Args&&... args)
+{
+    ItemType* item = placeAt(idx, hash, std::forward<Args>(args)...);
+    size_++;
+    return item;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename... Args>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType*
+HashTable<K,V,Prober,Hash,KEqual,Stats>::placeAt(HASH_INDEX_T idx, HASH_INDEX_T hash, Args&&... args)
+{
+    bool wasEmpty = (ctrl_[idx] == CTRL_EMPTY);
+    HASH_INDEX_T slot = makeRoom(idx, hash);
+    if (slot != idx) {
+        // idx already took the last item of the shifted run
+        if (wasEmpty) {
+            loadingCnt_++;
+        }
+        wasEmpty = false;
+    }
+    ItemType* item = new (table_[slot].bytes) ItemType(std::forward<Args>(args)...);
+    setCtrl(slot, tagOf(hash));
+    if (wasEmpty) {
         loadingCnt_++;
     }
-    else if (table_[idx]->item.first == p.first) {
-        table_[idx]->item.second = p.second; 
+    return item;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual,Stats>::makeRoom(HASH_INDEX_T idx, HASH_INDEX_T hash)
+{
+    if (!Prober::robinHood) {
+        return idx;
+    }
+    static_assert(!Prober::robinHood || Prober::contiguous,
+        "Robin Hood insertion requires a contiguous probe sequence");
+    // Every slot from the home slot up to idx is full.  Find the first
+    // resident displaced less than the new item would be at that slot.
+    HASH_INDEX_T m = capacity(mIndex_);
+    HASH_INDEX_T pos = Capacity::reduce(hash, mIndex_);
+    for (HASH_INDEX_T dist = 0; pos != idx; ++dist) {
+        HASH_INDEX_T home = Capacity::reduce(hash_(table_[pos].item()->first), mIndex_);
+        HASH_INDEX_T residentDist = (pos >= home) ? pos - home : pos + m - home;
+        if (residentDist < dist) {
+            break;
+        }
+        pos = (pos + 1 == m) ? 0 : pos + 1;
+    }
+    // Shift [pos, idx) one slot forward, back to front
+    for (HASH_INDEX_T dst = idx; dst != pos; ) {
+        HASH_INDEX_T src = (dst == 0) ? m - 1 : dst - 1;
+        new (table_[dst].bytes) ItemType(std::move(*table_[src].item()));
+        table_[src].item()->~ItemType();
+        setCtrl(dst, ctrl_[src]);
+        dst = src;
+    }
+    if (pos != idx) {
+        setCtrl(pos, CTRL_DELETED);
     }
+    return pos;
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-void HashTable<K,V,Prober,Hash,KEqual>::remove(const KeyType& key)
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::remove(const KeyType& key)
 {
-    HASH_INDEX_T idx = probe(key);
-    if(table_[idx] != nullptr && idx != npos) {
-        table_[idx]->deleted = true;
+    detach();
+    if(oldTable_ != nullptr) {
+        migrate(drainStep());
+    }
+    HASH_INDEX_T hash = hash_(key);
+    HASH_INDEX_T idx = probe(key, hash);
+    if(idx != npos && ctrl_[idx] >= 0) {
+        // the slot stays a tombstone so later probe sequences pass through it
+        table_[idx].item()->~ItemType();
+        setCtrl(idx, CTRL_DELETED);
         size_--;
+        if(oldTable_ == nullptr && tombstones() > tombAlpha_ * capacity(mIndex_)) {
+            purgeTombstones();
+        }
+    }
+    else if(oldTable_ != nullptr) {
+        HASH_INDEX_T oldM = capacity(oldMIndex_);
+        idx = probe(oldTable_, oldCtrl_, oldMIndex_, key, hash);
+        if(idx != npos && oldCtrl_[idx] >= 0) {
+            oldTable_[idx].item()->~ItemType();
+            setCtrl(oldCtrl_, oldM, idx, CTRL_DELETED);
+            size_--;
+            oldSize_--;
+        }
     }
 }   
 
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-typename HashTable<K,V,Prober,Hash,KEqual>::ItemType const * HashTable<K,V,Prober,Hash,KEqual>::find(const KeyType& key) const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType const * HashTable<K,V,Prober,Hash,KEqual,Stats>::find(const KeyType& key) const
 {
-    HASH_INDEX_T h = this->probe(key);
-    if((npos == h) || nullptr == table_[h] ){
-        return nullptr;
-    }
-    return &table_[h]->item;
+    return this->internalFind(key);
 }
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-typename HashTable<K,V,Prober,Hash,KEqual>::ItemType * HashTable<K,V,Prober,Hash,KEqual>::find(const KeyType& key)
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType * HashTable<K,V,Prober,Hash,KEqual,Stats>::find(const KeyType& key)
+{
+    if(oldTable_ != nullptr) {
+        migrate(drainStep());
+    }
+    return this->internalFind(key);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType const *
+HashTable<K,V,Prober,Hash,KEqual,Stats>::lookup(const KeyType& key, HASH_INDEX_T hash, size_t& probes) const
+{
+    return this->internalFind(key, hash, probes);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::prefetchHome(const HASH_INDEX_T* hashes, size_t n) const
+{
+    for(size_t i = 0; i < n; ++i) {
+        HASH_INDEX_T h = Capacity::reduce(hashes[i], mIndex_);
+        prefetch(ctrl_ + h);
+        prefetch(table_ + h);
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::find_batch(
+    const KeyType* keys, size_t n, ItemType const ** results) const
+{
+    HASH_INDEX_T hashes[BATCH_WIDTH];
+    for(size_t base = 0; base < n; base += BATCH_WIDTH) {
+        size_t cnt = std::min(BATCH_WIDTH, n - base);
+        for(size_t i = 0; i < cnt; ++i) {
+            hashes[i] = hash_(keys[base + i]);
+        }
+        prefetchHome(hashes, cnt);
+        for(size_t i = 0; i < cnt; ++i) {
+            HASH_INDEX_T probes;
+            results[base + i] = internalFind(keys[base + i], hashes[i], probes);
+        }
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::find_batch(
+    const KeyType* keys, size_t n, ItemType ** results)
+{
+    // same migration work as n calls to find(), but all of it before the
+    // first lookup: migrating later would move items that earlier results
+    // already point at
+    if(oldTable_ != nullptr) {
+        HASH_INDEX_T step = drainStep();
+        HASH_INDEX_T left = capacity(oldMIndex_) - migrateIdx_;
+        migrate((step == 0 || n < left / step) ? step * n : left);
+    }
+    HASH_INDEX_T hashes[BATCH_WIDTH];
+    for(size_t base = 0; base < n; base += BATCH_WIDTH) {
+        size_t cnt = std::min(BATCH_WIDTH, n - base);
+        for(size_t i = 0; i < cnt; ++i) {
+            hashes[i] = hash_(keys[base + i]);
+        }
+        prefetchHome(hashes, cnt);
+        for(size_t i = 0; i < cnt; ++i) {
+            results[base + i] = internalFind(keys[base + i], hashes[i]);
+        }
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::insert_batch(const ItemType* items, size_t n)
+{
+    HASH_INDEX_T hashes[BATCH_WIDTH];
+    for(size_t base = 0; base < n; base += BATCH_WIDTH) {
+        size_t cnt = std::min(BATCH_WIDTH, n - base);
+        for(size_t i = 0; i < cnt; ++i) {
+            hashes[i] = hash_(items[base + i].first);
+        }
+        // a resize part way through only wastes the remaining prefetches
+        prefetchHome(hashes, cnt);
+        for(size_t i = 0; i < cnt; ++i) {
+            const ItemType& p = items[base + i];
+            std::pair<ItemType*, HASH_INDEX_T> found = prepareInsert(p.first, hashes[i]);
+            if(found.first != nullptr) {
+                found.first->second = p.second;
+            }
+            else {
+                constructAt(found.second, hashes[i], p);
+            }
+        }
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::reserve(size_t n)
 {
-    HASH_INDEX_T h = this->probe(key);
-    if((npos == h) || nullptr == table_[h] ){
-        return nullptr;
+    HASH_INDEX_T target = mIndex_;
+    while((double)n/capacity(target) >= rAlpha_) {
+        if(target == Capacity::count-1) {
+            throw std::logic_error("Cannot resize further");
+        }
+        target++;
+    }
+    if(target != mIndex_) {
+        detach();
+        resize(target);
+        // a reserve is a one-off cost the caller asked for, so finish it now
+        if(oldTable_ != nullptr) {
+            migrate(capacity(oldMIndex_));
+        }
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename InputIt>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::bulk_insert(InputIt first, InputIt last)
+{
+    typedef typename std::iterator_traits<InputIt>::iterator_category Category;
+    if(!std::is_base_of<std::forward_iterator_tag, Category>::value) {
+        // a single-pass range cannot be counted ahead of time
+        for( ; first != last; ++first) {
+            insert(*first);
+        }
+    }
+    else {
+        size_t n = std::distance(first, last);
+        detach();
+        reserve(size_ + n);
+        if(oldTable_ != nullptr) {
+            migrate(capacity(oldMIndex_));
+        }
+        // reserve() sized for live items; tombstones may still be in the way
+        if((double)(loadingCnt_ + n)/capacity(mIndex_) >= rAlpha_) {
+            rehashInPlace();
+        }
+        for( ; first != last; ++first) {
+            auto&& p = *first;
+            HASH_INDEX_T hash = hash_(p.first);
+            std::pair<ItemType*, HASH_INDEX_T> found = findOrFree(p.first, hash);
+            if(found.first != nullptr) {
+                found.first->second = p.second;
+            }
+            else {
+                constructAt(found.second, hash, p);
+            }
+        }
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual,Stats>::nextFull(const CTRL_T* ctrl, HASH_INDEX_T m, HASH_INDEX_T i)
+{
+    // the cloned tail lets a group start anywhere in [0, m)
+    for( ; i < m; i += GROUP_WIDTH) {
+        uint32_t full = ~CtrlGroup(ctrl + i).matchNotFull() & ((1u << GROUP_WIDTH) - 1);
+        if(full != 0) {
+            return std::min(m, i + lowestBit(full));
+        }
+    }
+    return m;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename Item, typename F>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::visitRange(Item* table, const CTRL_T* ctrl, HASH_INDEX_T m,
+    HASH_INDEX_T lo, HASH_INDEX_T hi, F& f)
+{
+    for(HASH_INDEX_T i = nextFull(ctrl, m, lo); i < hi; i = nextFull(ctrl, m, i + 1)) {
+        f(*table[i].item());
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename F>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::for_each_chunk(size_t chunk, size_t chunks, F f)
+{
+    if(chunk >= chunks) {
+        throw std::invalid_argument("chunk must be in [0, chunks)");
+    }
+    HASH_INDEX_T m = capacity(mIndex_);
+    visitRange(table_, ctrl_, m, m * chunk / chunks, m * (chunk + 1) / chunks, f);
+    if(oldTable_ != nullptr) {
+        HASH_INDEX_T oldM = capacity(oldMIndex_);
+        visitRange(oldTable_, oldCtrl_, oldM, oldM * chunk / chunks, oldM * (chunk + 1) / chunks, f);
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename F>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::for_each_chunk(size_t chunk, size_t chunks, F f) const
+{
+    if(chunk >= chunks) {
+        throw std::invalid_argument("chunk must be in [0, chunks)");
+    }
+    HASH_INDEX_T m = capacity(mIndex_);
+    const Slot* table = table_;
+    visitRange(table, ctrl_, m, m * chunk / chunks, m * (chunk + 1) / chunks, f);
+    if(oldTable_ != nullptr) {
+        HASH_INDEX_T oldM = capacity(oldMIndex_);
+        const Slot* oldTable = oldTable_;
+        visitRange(oldTable, oldCtrl_, oldM, oldM * chunk / chunks, oldM * (chunk + 1) / chunks, f);
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename Pred>
+size_t HashTable<K,V,Prober,Hash,KEqual,Stats>::erase_if(Pred pred)
+{
+    detach();
+    size_t before = size_;
+    HASH_INDEX_T m = capacity(mIndex_);
+    for(HASH_INDEX_T i = nextFull(ctrl_, m, 0); i < m; i = nextFull(ctrl_, m, i + 1)) {
+        if(pred(static_cast<const ItemType&>(*table_[i].item()))) {
+            table_[i].item()->~ItemType();
+            setCtrl(i, CTRL_DELETED);
+            size_--;
+        }
+    }
+    if(oldTable_ != nullptr) {
+        HASH_INDEX_T oldM = capacity(oldMIndex_);
+        for(HASH_INDEX_T i = nextFull(oldCtrl_, oldM, 0); i < oldM; i = nextFull(oldCtrl_, oldM, i + 1)) {
+            if(pred(static_cast<const ItemType&>(*oldTable_[i].item()))) {
+                oldTable_[i].item()->~ItemType();
+                setCtrl(oldCtrl_, oldM, i, CTRL_DELETED);
+                size_--;
+                oldSize_--;
+            }
+        }
+        // frees the old table if that emptied it
+        migrate(0);
+    }
+    if(oldTable_ == nullptr && tombstones() > tombAlpha_ * m) {
+        rehashInPlace();
+    }
+    return before - size_;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::setTombstoneLimit(double fraction)
+{
+    tombAlpha_ = fraction;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::setIncrementalResize(size_t bucketsPerOp)
+{
+    migrateStep_ = bucketsPerOp;
+    if(migrateStep_ == 0 && oldTable_ != nullptr) {
+        migrate(capacity(oldMIndex_));
     }
-    return &table_[h]->item;
 }
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-const typename HashTable<K,V,Prober,Hash,KEqual>::ValueType& HashTable<K,V,Prober,Hash,KEqual>::at(const KeyType& key) const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+const typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ValueType& HashTable<K,V,Prober,Hash,KEqual,Stats>::at(const KeyType& key) const
 {
-    HashItem const * item = this->internalFind(key);
+    ItemType const * item = this->internalFind(key);
     if(item == nullptr) { throw std::out_of_range("Bad key"); }
-    return item->item.second;
+    return item->second;
 }
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-typename HashTable<K,V,Prober,Hash,KEqual>::ValueType& HashTable<K,V,Prober,Hash,KEqual>::at(const KeyType& key)
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ValueType& HashTable<K,V,Prober,Hash,KEqual,Stats>::at(const KeyType& key)
 {
-    HashItem * item = this->internalFind(key);
+    ItemType * item = this->internalFind(key);
     if(item == nullptr) { throw std::out_of_range("Bad key"); }
-    return item->item.second;
+    return item->second;
 }
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-const typename HashTable<K,V,Prober,Hash,KEqual>::ValueType& HashTable<K,V,Prober,Hash,KEqual>::operator[](const KeyType& key) const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+const typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ValueType& HashTable<K,V,Prober,Hash,KEqual,Stats>::operator[](const KeyType& key) const
 {
     return this->at(key);
 }
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-typename HashTable<K,V,Prober,Hash,KEqual>::ValueType& HashTable<K,V,Prober,Hash,KEqual>::operator[](const KeyType& key)
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ValueType& HashTable<K,V,Prober,Hash,KEqual,Stats>::operator[](const KeyType& key)
 {
     return this->at(key);
 }
 
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-typename HashTable<K,V,Prober,Hash,KEqual>::HashItem* HashTable<K,V,Prober,Hash,KEqual>::internalFind(const KeyType& key) const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename Q>
+typename HashTable<K,V,Prober,Hash,KEqual,Stats>::ItemType* HashTable<K,V,Prober,Hash,KEqual,Stats>::internalFind(const Q& key, HASH_INDEX_T hash, HASH_INDEX_T& probes) const
 {
-    HASH_INDEX_T h = this->probe(key);
-    if((npos == h) || nullptr == table_[h] ){
-        return nullptr;
+    HASH_INDEX_T n;
+    HASH_INDEX_T h = this->probe(table_, ctrl_, mIndex_, key, hash, n);
+    probes = n;
+    if((npos != h) && ctrl_[h] >= 0 ){
+        return table_[h].item();
     }
-    return table_[h];
+    if(oldTable_ != nullptr) {
+        h = this->probe(oldTable_, oldCtrl_, oldMIndex_, key, hash, n);
+        probes += n;
+        if((npos != h) && oldCtrl_[h] >= 0) {
+            return oldTable_[h].item();
+        }
+    }
+    return nullptr;
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-void HashTable<K,V,Prober,Hash,KEqual>::resize()
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::resize(HASH_INDEX_T newMIndex)
 {
-    if( mIndex_ == sizeof(CAPACITIES)/sizeof(CAPACITIES[0])-1)
+    // normally drained already (see drainStep())
+    if(oldTable_ != nullptr) {
+        migrate(capacity(oldMIndex_));
+    }
+    if( newMIndex >= Capacity::count)
     {
         throw std::logic_error("Cannot resize further");
     }
-    std::cout << "-----before: " << std::endl;
-    reportAll(std::cout);
-    std::cout << "------------" << std::endl;
-    // Add your resize code below
-    // std::cout << "resize" << std::endl;
-    std::vector<HashItem*> temp = table_;
-    table_.clear();
-    table_.resize(CAPACITIES[++mIndex_]);
-    size_ = 0;
+    if(newMIndex == mIndex_) {
+        stats_.recordCompaction();
+    }
+    else {
+        stats_.recordResize();
+    }
+    // The current table becomes the old one and is drained by migrate(),
+    // which drops tombstones and moves each live item exactly once
+    oldTable_ = table_;
+    oldCtrl_ = ctrl_;
+    oldMIndex_ = mIndex_;
+    oldSize_ = size_;
+    migrateIdx_ = 0;
+    mIndex_ = newMIndex;
+    allocate(capacity(mIndex_), table_, ctrl_);
     loadingCnt_ = 0;
-    for(size_t i = 0; i < temp.size(); i++) {
-        if (temp[i] != nullptr && temp[i]->deleted == false) insert(temp[i]->item);
-    }   
-    
-    std::cout << "-----after: " << std::endl;
-    reportAll(std::cout);
-    std::cout << "------------" << std::endl;
+    migrate(migrateStep_ == 0 ? capacity(oldMIndex_) : drainStep());
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual,Stats>::drainStep() const
+{
+    // The next resize or purge comes when the load reaches rAlpha_ of the
+    // capacity.  Only inserts add to the load, and every one of them
+    // migrates, so spread the old slots left over the inserts left.
+    HASH_INDEX_T left = capacity(oldMIndex_) - migrateIdx_;
+    double inserts = rAlpha_ * capacity(mIndex_) - (double)(loadingCnt_ + oldSize_);
+    if(inserts < 1) {
+        return left;
+    }
+    HASH_INDEX_T minStep = (HASH_INDEX_T)std::ceil(left / inserts);
+    return std::max<HASH_INDEX_T>(migrateStep_, minStep);
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::purgeTombstones()
+{
+    if(migrateStep_ == 0) {
+        rehashInPlace();
+    }
+    else {
+        resize(mIndex_);
+    }
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::migrate(HASH_INDEX_T buckets)
+{
+    stats_.beginRehash();
+    HASH_INDEX_T oldM = capacity(oldMIndex_);
+    HASH_INDEX_T stop = std::min(oldM, migrateIdx_ + buckets);
+    for( ; migrateIdx_ < stop && oldSize_ > 0; ++migrateIdx_) {
+        if(oldCtrl_[migrateIdx_] >= 0) {
+            moveIn(oldTable_[migrateIdx_].item());
+            // a tombstone keeps later old-table probe sequences intact
+            setCtrl(oldCtrl_, oldM, migrateIdx_, CTRL_DELETED);
+            oldSize_--;
+        }
+    }
+    if(oldSize_ == 0) {
+        // no live items remain, so skip destroy()'s O(m) scan
+        delete [] oldTable_;
+        delete [] oldCtrl_;
+        oldTable_ = nullptr;
+        oldCtrl_ = nullptr;
+    }
+    stats_.endRehash();
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::rehashInPlace()
+{
+    stats_.recordCompaction();
+    stats_.beginRehash();
+    HASH_INDEX_T m = capacity(mIndex_);
+    // Tombstones become empty and live items are marked deleted, meaning
+    // "not yet placed".  Each item is then moved to the first non-full
+    // slot of its probe sequence; if that slot holds another unplaced
+    // item the two are swapped and the displaced one is placed next.
+    // Every step fills one more slot, so the pass is O(m).
+    for(HASH_INDEX_T i = 0; i < m; ++i) {
+        ctrl_[i] = (ctrl_[i] < 0) ? CTRL_EMPTY : CTRL_DELETED;
+    }
+    for(HASH_INDEX_T i = m; i < m + GROUP_WIDTH - 1; ++i) {
+        ctrl_[i] = ctrl_[i % m];
+    }
+    for(HASH_INDEX_T i = 0; i < m; ++i) {
+        if(ctrl_[i] != CTRL_DELETED) {
+            continue;
+        }
+        ItemType* item = table_[i].item();
+        HASH_INDEX_T hash = hash_(item->first);
+        HASH_INDEX_T target = probeFree(hash);
+        if(target == npos) {
+            // A prober that visits only part of the table (QuadraticProber
+            // sees about m/2 slots) can find them all taken when the load
+            // factor is above 1/2.  Mark the unplaced items full, which
+            // they are, and grow; resize() only reads the control bytes.
+            for(HASH_INDEX_T j = i; j < m; ++j) {
+                if(ctrl_[j] == CTRL_DELETED) {
+                    setCtrl(j, tagOf(hash_(table_[j].item()->first)));
+                }
+            }
+            loadingCnt_ = size_;
+            stats_.endRehash();
+            resize();
+            // the old table is not in probe order, so it cannot serve lookups
+            migrate(capacity(oldMIndex_));
+            return;
+        }
+        if(target == i) {
+            setCtrl(i, tagOf(hash));
+        }
+        else if(ctrl_[target] == CTRL_EMPTY) {
+            new (table_[target].bytes) ItemType(std::move(*item));
+            item->~ItemType();
+            setCtrl(target, tagOf(hash));
+            setCtrl(i, CTRL_EMPTY);
+        }
+        else {
+            std::swap(*item, *table_[target].item());
+            setCtrl(target, tagOf(hash));
+            --i;
+        }
+    }
+    loadingCnt_ = size_;
+    stats_.endRehash();
 }
 
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual>::probe(const KeyType& key) const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::moveIn(ItemType* item)
 {
-    HASH_INDEX_T h = hash_(key) % CAPACITIES[mIndex_];
-    std::cout << "key: " << key << ", h: " << h << std::endl;
-    prober_.init(h, CAPACITIES[mIndex_]);
+    HASH_INDEX_T hash = hash_(item->first);
+    HASH_INDEX_T idx = probeFree(hash);
+    if(idx == npos) {
+        throw std::logic_error("no free location");
+    }
+    placeAt(idx, hash, std::move(*item));
+    item->~ItemType();
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+template<typename Q>
+HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual,Stats>::probe(const Slot* table, const CTRL_T* ctrl,
+    HASH_INDEX_T mIndex, const Q& key, HASH_INDEX_T hash, HASH_INDEX_T& probes) const
+{
+    HASH_INDEX_T m = capacity(mIndex);
+    HASH_INDEX_T h = Capacity::reduce(hash, mIndex);
+    CTRL_T tag = tagOf(hash);
+
+    if(Prober::contiguous) {
+        // Scan GROUP_WIDTH control bytes per step.  Only tag matches ahead
+        // of the first empty byte can hold the key.
+        HASH_INDEX_T pos = h;
+        for(HASH_INDEX_T scanned = 0; scanned < m; scanned += GROUP_WIDTH) {
+            CtrlGroup group(ctrl + pos);
+            uint32_t valid = (m - scanned >= GROUP_WIDTH) ? 0xFFFFu : ((1u << (m - scanned)) - 1);
+            uint32_t emptyMask = group.matchEmpty() & valid;
+            uint32_t live = emptyMask ? (emptyMask & (0u - emptyMask)) - 1 : valid;
+            for(uint32_t hits = group.match(tag) & live; hits; hits &= hits - 1) {
+                HASH_INDEX_T loc = pos + lowestBit(hits);
+                if(loc >= m) loc -= m;
+                if(kequal_(table[loc].item()->first, key)) {
+                    probes = scanned + lowestBit(hits) + 1;
+                    return loc;
+                }
+            }
+            if(emptyMask) {
+                HASH_INDEX_T loc = pos + lowestBit(emptyMask);
+                probes = scanned + lowestBit(emptyMask) + 1;
+                return (loc >= m) ? loc - m : loc;
+            }
+            // when m < GROUP_WIDTH the first group covered the whole table and
+            // the loop ends here, so one subtract always wraps pos
+            pos += GROUP_WIDTH;
+            if(pos >= m) pos -= m;
+        }
+        probes = m;
+        return npos;
+    }
 
-    HASH_INDEX_T loc = prober_.next(); 
-    totalProbes_++;
+    Prober prober(prober_);
+    prober.init(h, m, hash);
+
+    HASH_INDEX_T loc = prober.next(); 
+    probes = 1;
     while(Prober::npos != loc)
     {
-        if(nullptr == table_[loc] ) {
+        if(CTRL_EMPTY == ctrl[loc]) {
             return loc;
         }
         // fill in the condition for this else if statement which should 
         // return 'loc' if the given key exists at this location
-        else if(kequal_(table_[loc]->item.first, key) && table_[loc]->deleted == false) {
+        else if(tag == ctrl[loc] && kequal_(table[loc].item()->first, key)) {
             return loc;
         }
-        loc = prober_.next();
-        totalProbes_++;
+        loc = prober.next();
+        probes++;
     }
 
+    probes--;
     return npos;
 }
 
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HASH_INDEX_T HashTable<K,V,Prober,Hash,KEqual,Stats>::probeFree(HASH_INDEX_T hash) const
+{
+    HASH_INDEX_T m = capacity(mIndex_);
+    HASH_INDEX_T h = Capacity::reduce(hash, mIndex_);
+
+    if(Prober::contiguous) {
+        HASH_INDEX_T pos = h;
+        for(HASH_INDEX_T scanned = 0; scanned < m; scanned += GROUP_WIDTH) {
+            uint32_t valid = (m - scanned >= GROUP_WIDTH) ? 0xFFFFu : ((1u << (m - scanned)) - 1);
+            uint32_t freeMask = CtrlGroup(ctrl_ + pos).matchNotFull() & valid;
+            if(freeMask) {
+                HASH_INDEX_T loc = pos + lowestBit(freeMask);
+                return (loc >= m) ? loc - m : loc;
+            }
+            pos += GROUP_WIDTH;
+            if(pos >= m) pos -= m;
+        }
+        return npos;
+    }
+
+    Prober prober(prober_);
+    prober.init(h, m, hash);
+    for(HASH_INDEX_T loc = prober.next(); Prober::npos != loc; loc = prober.next()) {
+        if(ctrl_[loc] < 0) {
+            return loc;
+        }
+    }
+    return npos;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+HashTableStats HashTable<K,V,Prober,Hash,KEqual,Stats>::stats() const
+{
+    HashTableStats s = HashTableStats();
+    s.totalProbes = totalProbes_;
+    s.tombstones = tombstones();
+    stats_.report(s);
+    return s;
+}
+
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K,V,Prober,Hash,KEqual,Stats>::clearStats()
+{
+    totalProbes_ = 0;
+    stats_.clear();
+}
+
 // Complete
-template<typename K, typename V, typename Prober, typename Hash, typename KEqual>
-void HashTable<K, V, Prober, Hash, KEqual>::reportAll(std::ostream& out) const
+template<typename K, typename V, typename Prober, typename Hash, typename KEqual, typename Stats>
+void HashTable<K, V, Prober, Hash, KEqual, Stats>::reportAll(std::ostream& out) const
 {
-	for(HASH_INDEX_T i = 0; i < CAPACITIES[mIndex_]; ++i)
+	for(HASH_INDEX_T i = 0; i < capacity(mIndex_); ++i)
+	{
+		if(ctrl_[i] >= 0)
+		{
+			out << "Bucket " << i << ": " << table_[i].item()->first << " " << table_[i].item()->second << std::endl;
+		}
+	}
+	for(HASH_INDEX_T i = 0; oldTable_ != nullptr && i < capacity(oldMIndex_); ++i)
 	{
-		if(table_[i] != nullptr)
+		if(oldCtrl_[i] >= 0)
 		{
-			out << "Bucket " << i << ": " << table_[i]->item.first << " " << table_[i]->item.second << std::endl;
+			out << "Old bucket " << i << ": " << oldTable_[i].item()->first << " " << oldTable_[i].item()->second << std::endl;
 		}
 	}
 }
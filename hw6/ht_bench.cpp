@@ -0,0 +1,282 @@
+// Benchmark harness for HashTable: every prober over a sweep of resize
+// thresholds, on integer and string keys drawn uniformly or from a Zipf
+// distribution, compared against std::unordered_map.
+//
+// Build and run:
+//   g++ -std=c++17 -O2 -DNDEBUG ht_bench.cpp -o ht_bench
+//   ./ht_bench [items] [filter]
+//
+// items defaults to 200000.  Only configurations whose name contains
+// filter (e.g. "robin", "string", "zipf", "unordered") are run.
+//
+// Operations, each reported as ns/op and probes/op:
+//   insert    build the table from empty, one insert() per key
+//   reserved  the same build after reserve(items); the difference between
+//             the two is the cost of resizing
+//   hit       find() of present keys, drawn from the distribution
+//   miss      find() of absent keys, drawn from the distribution
+//   remove    remove() of half of the keys, each once
+//   churn     remove the oldest key and insert a new one, size held steady
+// bytes/entry counts slot and control arrays (node and bucket allocations
+// for unordered_map) per item after the build, not key heap storage.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "ht.h"
+
+using namespace std;
+
+// ------------------------------ Key generation ------------------------------
+
+struct SplitMix {
+    uint64_t s;
+    uint64_t next()
+    {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+template<typename Key> Key makeKey(uint64_t r);
+template<> uint64_t makeKey<uint64_t>(uint64_t r) { return r; }
+template<> string makeKey<string>(uint64_t r) { return "key_" + to_string(r); }
+
+// Draws ranks in [0, n) with P(rank k) proportional to 1/(k+1)^s
+class Zipf {
+public:
+    Zipf(size_t n, double s) : cdf_(n)
+    {
+        double sum = 0;
+        for(size_t k = 0; k < n; ++k) {
+            sum += 1.0 / pow((double)(k + 1), s);
+            cdf_[k] = sum;
+        }
+        for(double& c : cdf_) {
+            c /= sum;
+        }
+    }
+    size_t operator()(SplitMix& rng) const
+    {
+        double u = (rng.next() >> 11) * (1.0 / 9007199254740992.0);
+        return min(cdf_.size() - 1, (size_t)(lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin()));
+    }
+private:
+    vector<double> cdf_;
+};
+
+// Keys and pre-drawn operation sequences shared by every table
+template<typename Key>
+struct Workload {
+    vector<Key> present;   // built into the table
+    vector<Key> absent;    // never inserted; the first half feeds churn
+    vector<Key> hits;
+    vector<Key> misses;
+
+    Workload(size_t n, bool zipf)
+    {
+        SplitMix rng{42};
+        for(size_t i = 0; i < n; ++i) {
+            present.push_back(makeKey<Key>(rng.next()));
+            absent.push_back(makeKey<Key>(rng.next()));
+        }
+        // Zipf ranks are mapped through a fixed permutation so the hot
+        // keys are scattered across the table rather than the first built
+        Zipf z(n, 0.99);
+        SplitMix draw{7};
+        for(size_t i = 0; i < n; ++i) {
+            size_t a = zipf ? z(draw) : draw.next() % n;
+            size_t b = zipf ? z(draw) : draw.next() % n;
+            hits.push_back(present[(a * 2654435761u) % n]);
+            misses.push_back(absent[(b * 2654435761u) % n]);
+        }
+    }
+};
+
+// ------------------------------ Table adapters ------------------------------
+
+template<typename K, typename P>
+using BenchTable = HashTable<K, uint64_t, P>;
+
+template<typename K, typename P>
+void insertKey(BenchTable<K,P>& t, const K& k, uint64_t v) { t.insert(make_pair(k, v)); }
+template<typename K, typename P>
+bool findKey(BenchTable<K,P>& t, const K& k) { return t.find(k) != nullptr; }
+template<typename K, typename P>
+void removeKey(BenchTable<K,P>& t, const K& k) { t.remove(k); }
+template<typename K, typename P>
+void reserveKeys(BenchTable<K,P>& t, size_t n) { t.reserve(n); }
+template<typename K, typename P>
+size_t probes(const BenchTable<K,P>& t) { return t.totalProbes(); }
+template<typename K, typename P>
+size_t bytesUsed(const BenchTable<K,P>& t)
+{
+    return t.bucket_count() * (sizeof(typename BenchTable<K,P>::Slot) + sizeof(CTRL_T)) + GROUP_WIDTH - 1;
+}
+
+// Counts the bytes unordered_map allocates for its nodes and buckets
+size_t allocatedBytes = 0;
+template<typename T>
+struct CountingAllocator {
+    typedef T value_type;
+    CountingAllocator() {}
+    template<typename U> CountingAllocator(const CountingAllocator<U>&) {}
+    T* allocate(size_t n)
+    {
+        allocatedBytes += n * sizeof(T);
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n)
+    {
+        allocatedBytes -= n * sizeof(T);
+        ::operator delete(p);
+    }
+    template<typename U> bool operator==(const CountingAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+template<typename K>
+using StdTable = unordered_map<K, uint64_t, hash<K>, equal_to<K>,
+    CountingAllocator<pair<const K, uint64_t> > >;
+
+template<typename K>
+void insertKey(StdTable<K>& t, const K& k, uint64_t v) { t[k] = v; }
+template<typename K>
+bool findKey(StdTable<K>& t, const K& k) { return t.find(k) != t.end(); }
+template<typename K>
+void removeKey(StdTable<K>& t, const K& k) { t.erase(k); }
+template<typename K>
+void reserveKeys(StdTable<K>& t, size_t n) { t.reserve(n); }
+template<typename K>
+size_t probes(const StdTable<K>&) { return 0; }
+template<typename K>
+size_t bytesUsed(const StdTable<K>&) { return allocatedBytes; }
+
+// --------------------------------- Driver -----------------------------------
+
+typedef chrono::steady_clock Clock;
+
+struct Timing {
+    double ns;      // per operation
+    double probes;  // per operation, or -1 if the table does not count them
+};
+
+// Times fn(i) for i in [0, n) on t
+template<typename Table, typename F>
+Timing timeOp(Table& t, size_t n, F fn)
+{
+    size_t p0 = probes(t);
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        fn(i);
+    }
+    Timing r;
+    r.ns = chrono::duration<double, nano>(Clock::now() - start).count() / n;
+    r.probes = (probes(t) == 0) ? -1 : (double)(probes(t) - p0) / n;
+    return r;
+}
+
+void report(const string& name, const char* op, Timing r, double bytes = -1)
+{
+    printf("%-44s %-9s %9.1f", name.c_str(), op, r.ns);
+    if(r.probes >= 0) printf(" %10.2f", r.probes); else printf(" %10s", "-");
+    if(bytes >= 0) printf(" %12.1f\n", bytes); else printf(" %12s\n", "");
+}
+
+template<typename Table, typename Key>
+void runTable(const string& name, const Table& proto, const Workload<Key>& w)
+{
+    size_t n = w.present.size();
+    size_t half = n / 2;
+    volatile size_t sink = 0;
+    try {
+        {
+            allocatedBytes = 0;
+            Table t = proto;
+            Timing r = timeOp(t, n, [&](size_t i) { insertKey(t, w.present[i], i); });
+            report(name, "insert", r, (double)bytesUsed(t) / n);
+        }
+        {
+            Table t = proto;
+            reserveKeys(t, n);
+            report(name, "reserved", timeOp(t, n, [&](size_t i) { insertKey(t, w.present[i], i); }));
+        }
+        Table t = proto;
+        for(size_t i = 0; i < n; ++i) {
+            insertKey(t, w.present[i], i);
+        }
+        report(name, "hit", timeOp(t, n, [&](size_t i) { sink = sink + findKey(t, w.hits[i]); }));
+        report(name, "miss", timeOp(t, n, [&](size_t i) { sink = sink + findKey(t, w.misses[i]); }));
+        {
+            Table c = t;
+            report(name, "remove", timeOp(c, half, [&](size_t i) { removeKey(c, w.present[i]); }));
+        }
+        report(name, "churn", timeOp(t, half, [&](size_t i) {
+            removeKey(t, w.present[i]);
+            insertKey(t, w.absent[i], i);
+        }));
+    }
+    catch(std::logic_error& e) {
+        printf("%-44s failed: %s\n", name.c_str(), e.what());
+    }
+}
+
+bool selected(const string& name, const string& filter)
+{
+    return filter.empty() || name.find(filter) != string::npos;
+}
+
+template<typename Key, typename P>
+void runProber(const char* prober, const char* keyName, const char* dist,
+    const Workload<Key>& w, const string& filter)
+{
+    static const double alphas[] = { 0.25, 0.4, 0.5, 0.7, 0.85 };
+    for(double alpha : alphas) {
+        char name[128];
+        snprintf(name, sizeof(name), "%s/%s/%s/alpha=%.2f", prober, keyName, dist, alpha);
+        if(selected(name, filter)) {
+            runTable(name, BenchTable<Key,P>(alpha), w);
+        }
+    }
+}
+
+template<typename Key>
+void runKeyType(const char* keyName, size_t n, const string& filter)
+{
+    for(int zipf = 0; zipf < 2; ++zipf) {
+        const char* dist = zipf ? "zipf" : "uniform";
+        Workload<Key> w(n, zipf);
+        runProber<Key, LinearProber>("linear", keyName, dist, w, filter);
+        runProber<Key, QuadraticProber>("quadratic", keyName, dist, w, filter);
+        runProber<Key, Pow2LinearProber>("pow2linear", keyName, dist, w, filter);
+        runProber<Key, TriangularProber>("triangular", keyName, dist, w, filter);
+        runProber<Key, DoubleHashProber>("doublehash", keyName, dist, w, filter);
+        runProber<Key, RobinHoodProber>("robinhood", keyName, dist, w, filter);
+        string name = string("unordered_map/") + keyName + "/" + dist;
+        if(selected(name, filter)) {
+            runTable(name, StdTable<Key>(), w);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 200000;
+    string filter = (argc > 2) ? argv[2] : "";
+    if(n < 2) {
+        fprintf(stderr, "usage: %s [items >= 2] [filter]\n", argv[0]);
+        return 1;
+    }
+    printf("%-44s %-9s %9s %10s %12s\n", "table", "op", "ns/op", "probes/op", "bytes/entry");
+    runKeyType<uint64_t>("int", n, filter);
+    runKeyType<string>("string", n, filter);
+    return 0;
+}
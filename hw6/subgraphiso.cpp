@@ -0,0 +1,262 @@
+#include <algorithm>
+#include "subgraphiso.h"
+
+using namespace std;
+
+namespace {
+
+// Most signature words cached for target vertices (4 MiB).  The cache is
+// emptied when it would grow past this, so on a large target its memory
+// stays bounded however many vertices the search reaches.
+const size_t SIGNATURE_CACHE_WORDS = 1 << 20;
+
+}  // namespace
+
+SubgraphMatcher::SubgraphMatcher(const CsrGraph& pattern, const CsrGraph& target, bool induced)
+    : p_(pattern), t_(target), induced_(induced),
+      directed_(!pattern.symmetric() || !target.symmetric()), k_(pattern.numVertices()),
+      maxOut_(0), maxIn_(0), frames_(pattern.numVertices()),
+      image_(pattern.numVertices(), INVALID_VERTEX), map_(pattern.numVertices(), INVALID_VERTEX),
+      top_(0), started_(false)
+{
+    computeOrder();
+    for(VERTEX_ID_T u = 0; u < k_; ++u) {
+        maxOut_ = max(maxOut_, p_.degree(u));
+        if(directed_) {
+            maxIn_ = max(maxIn_, p_.inDegree(u));
+        }
+    }
+    size_t len = maxOut_ + maxIn_;
+    psig_.resize(k_ * len);
+    for(size_t d = 0; d < k_; ++d) {
+        signature(p_, order_[d], psig_.data() + d * len);
+    }
+}
+
+void SubgraphMatcher::computeOrder()
+{
+    // Greedy: the unordered vertex with the most ordered neighbours, then
+    // the highest degree, so each component starts at its best connected
+    // vertex and every later vertex is anchored by an earlier neighbour.
+    // Patterns are small, so O(k^2) is fine.
+    vector<char> ordered(k_, 0);
+    vector<uint32_t> conn(k_, 0);
+    vector<uint32_t> pos(k_);
+    auto degree = [this](VERTEX_ID_T u) { return p_.degree(u) + p_.inDegree(u); };
+    order_.clear();
+    for(size_t d = 0; d < k_; ++d) {
+        VERTEX_ID_T best = INVALID_VERTEX;
+        for(VERTEX_ID_T u = 0; u < k_; ++u) {
+            if(!ordered[u] && (best == INVALID_VERTEX || conn[u] > conn[best] ||
+                               (conn[u] == conn[best] && degree(u) > degree(best)))) {
+                best = u;
+            }
+        }
+        ordered[best] = 1;
+        pos[best] = d;
+        order_.push_back(best);
+        for(VERTEX_ID_T x : p_.neighbors(best)) {
+            conn[x]++;
+        }
+        if(!p_.symmetric()) {
+            for(VERTEX_ID_T x : p_.inNeighbors(best)) {
+                conn[x]++;
+            }
+        }
+    }
+    back_.assign(k_, vector<BackEdge>());
+    for(size_t d = 0; d < k_; ++d) {
+        VERTEX_ID_T u = order_[d];
+        for(VERTEX_ID_T w : p_.neighbors(u)) {
+            if(pos[w] < d) {
+                BackEdge b = { pos[w], true, p_.edgeExists(w, u) };
+                back_[d].push_back(b);
+            }
+        }
+        for(VERTEX_ID_T w : p_.inNeighbors(u)) {
+            if(pos[w] < d && !p_.edgeExists(u, w)) {
+                BackEdge b = { pos[w], false, true };
+                back_[d].push_back(b);
+            }
+        }
+    }
+}
+
+void SubgraphMatcher::signature(const CsrGraph& g, VERTEX_ID_T u, uint32_t* out) const
+{
+    auto part = [&](VertexRange r, size_t len) {
+        scratch_.clear();
+        for(VERTEX_ID_T x : r) {
+            scratch_.push_back(g.degree(x) + g.inDegree(x));
+        }
+        size_t keep = min(len, scratch_.size());
+        partial_sort(scratch_.begin(), scratch_.begin() + keep, scratch_.end(), greater<uint32_t>());
+        copy(scratch_.begin(), scratch_.begin() + keep, out);
+        fill(out + keep, out + len, 0);
+        out += len;
+    };
+    part(g.neighbors(u), maxOut_);
+    if(maxIn_ > 0) {
+        part(g.inNeighbors(u), maxIn_);
+    }
+}
+
+const uint32_t* SubgraphMatcher::targetSignature(VERTEX_ID_T v)
+{
+    const pair<VERTEX_ID_T, uint32_t>* at = tsigAt_.find(v);
+    if(at != nullptr) {
+        return tsig_.data() + at->second;
+    }
+    size_t len = maxOut_ + maxIn_;
+    if(tsig_.size() + len > SIGNATURE_CACHE_WORDS && !tsig_.empty()) {
+        tsig_.clear();
+        tsigAt_ = HashTable<VERTEX_ID_T, uint32_t>();
+    }
+    uint32_t off = tsig_.size();
+    tsig_.resize(off + len);
+    signature(t_, v, tsig_.data() + off);
+    tsigAt_.try_emplace(v, off);
+    return tsig_.data() + off;
+}
+
+SubgraphMatcher::Frame SubgraphMatcher::candidates(size_t depth) const
+{
+    Frame f = { { nullptr, nullptr }, 0, back_[depth].empty() };
+    // u -> w needs v -> image(w): v is an in-neighbour of the image, and
+    // the other way round; take the smallest such range
+    size_t best = SIZE_MAX;
+    for(const BackEdge& b : back_[depth]) {
+        VERTEX_ID_T x = image_[b.depth];
+        VertexRange r = b.out ? t_.inNeighbors(x) : t_.neighbors(x);
+        if(r.size() < best) {
+            best = r.size();
+            f.range = r;
+        }
+    }
+    return f;
+}
+
+VERTEX_ID_T SubgraphMatcher::nextCandidate(Frame& f) const
+{
+    if(f.all) {
+        return f.scan < t_.numVertices() ? f.scan++ : INVALID_VERTEX;
+    }
+    return f.range.first != f.range.last ? *f.range.first++ : INVALID_VERTEX;
+}
+
+bool SubgraphMatcher::feasible(size_t depth, VERTEX_ID_T v)
+{
+    VERTEX_ID_T u = order_[depth];
+    if(t_.degree(v) < p_.degree(u) || t_.inDegree(v) < p_.inDegree(u)) {
+        return false;
+    }
+    bool loop1 = p_.edgeExists(u, u), loop2 = t_.edgeExists(v, v);
+    if(induced_ ? loop1 != loop2 : loop1 && !loop2) {
+        return false;
+    }
+    for(size_t j = 0; j < depth; ++j) {
+        if(image_[j] == v) {
+            return false;
+        }
+    }
+    size_t len = maxOut_ + maxIn_;
+    if(len > 0) {
+        // the pattern neighbours map to distinct target neighbours of at
+        // least their degree, so sorted degrees must dominate pairwise
+        const uint32_t* s1 = psig_.data() + depth * len;
+        const uint32_t* s2 = targetSignature(v);
+        for(size_t i = 0; i < len; ++i) {
+            if(s1[i] > s2[i]) {
+                return false;
+            }
+        }
+    }
+    if(induced_) {
+        // every matched pair must agree on edges in both directions
+        for(size_t j = 0; j < depth; ++j) {
+            VERTEX_ID_T w = order_[j], x = image_[j];
+            if(p_.edgeExists(u, w) != t_.edgeExists(v, x)) {
+                return false;
+            }
+            if(directed_ && p_.edgeExists(w, u) != t_.edgeExists(x, v)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    for(const BackEdge& b : back_[depth]) {
+        VERTEX_ID_T x = image_[b.depth];
+        if(b.out && !t_.edgeExists(v, x)) {
+            return false;
+        }
+        if(b.in && directed_ && !t_.edgeExists(x, v)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SubgraphMatcher::next()
+{
+    if(!started_) {
+        started_ = true;
+        if(k_ > t_.numVertices() || p_.numEdges() > t_.numEdges()) {
+            return false;
+        }
+        if(k_ == 0) {
+            return true;    // the empty mapping, once
+        }
+        frames_[0] = candidates(0);
+        top_ = 1;
+    }
+    while(top_ > 0) {
+        size_t depth = top_ - 1;
+        image_[depth] = INVALID_VERTEX;
+        Frame& f = frames_[depth];
+        VERTEX_ID_T v = nextCandidate(f);
+        while(v != INVALID_VERTEX && !feasible(depth, v)) {
+            v = nextCandidate(f);
+        }
+        if(v == INVALID_VERTEX) {
+            top_--;
+            continue;
+        }
+        image_[depth] = v;
+        map_[order_[depth]] = v;
+        if(depth + 1 == k_) {
+            return true;
+        }
+        frames_[top_++] = candidates(depth + 1);
+    }
+    return false;
+}
+
+size_t csrSubgraphIso(const CsrGraph& pattern, const CsrGraph& target,
+                      const function<bool(const vector<VERTEX_ID_T>&)>& onMatch,
+                      const SubgraphOptions& options)
+{
+    SubgraphMatcher matcher(pattern, target, options.induced);
+    size_t count = 0;
+    while((options.limit == 0 || count < options.limit) && matcher.next()) {
+        count++;
+        if(!onMatch(matcher.mapping())) {
+            break;
+        }
+    }
+    return count;
+}
+
+size_t subgraphIso(const Graph& pattern, const Graph& target,
+                   const function<bool(const VERTEX_ID_MAP_T&)>& onMatch,
+                   const SubgraphOptions& options)
+{
+    CsrGraph p(pattern), t(target);
+    // every match assigns the same keys, so one map is reused throughout
+    VERTEX_ID_MAP_T mapping;
+    return csrSubgraphIso(p, t, [&](const vector<VERTEX_ID_T>& map) {
+        for(VERTEX_ID_T u = 0; u < p.numVertices(); ++u) {
+            mapping.insert_or_assign(p.name(u), t.name(map[u]));
+        }
+        return onMatch(mapping);
+    }, options);
+}
@@ -0,0 +1,116 @@
+#ifndef SUBGRAPHISO_H
+#define SUBGRAPHISO_H
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "csrgraph.h"
+#include "ht.h"
+
+// Options for subgraph matching
+struct SubgraphOptions {
+    // Induced: pattern vertices may only map to target vertices with
+    // exactly the pattern's edges among them.  Otherwise target edges
+    // between images that the pattern lacks are allowed.
+    bool induced = false;
+    // Stop after this many matches; 0 reports them all
+    size_t limit = 0;
+};
+
+/**
+ * @brief Enumerates the embeddings of a pattern graph in a target graph,
+ * one per call to next(), so callers can stop whenever they like
+ *
+ * An embedding maps pattern vertices to distinct target vertices so that
+ * every pattern edge u -> w has a target edge image(u) -> image(w) (and,
+ * when induced, no other target edges join images).  Every such mapping is
+ * reported once, so a pattern with automorphisms matches each set of
+ * target vertices several times.
+ *
+ * Pattern vertices are matched in a fixed order in which each vertex
+ * after a component's first is adjacent to an earlier one, and candidates
+ * are drawn from the target neighbours of that neighbour's image, so away
+ * from component roots the work follows the matches rather than the size
+ * of the target.  A candidate must also have at least the pattern
+ * vertex's out- and in-degree, and its neighbours' degrees must dominate
+ * the pattern neighbours' degrees once both are sorted.  These per-vertex
+ * signatures are computed only for target vertices the search reaches,
+ * and cached up to a fixed size, past which the cache starts over.
+ */
+class SubgraphMatcher
+{
+public:
+    SubgraphMatcher(const CsrGraph& pattern, const CsrGraph& target, bool induced = false);
+
+    /**
+     * @brief Advances to the next embedding
+     *
+     * @return true with the embedding in mapping(); false once there are
+     * no more
+     */
+    bool next();
+
+    // Target vertex matched to each pattern vertex by the last next()
+    const std::vector<VERTEX_ID_T>& mapping() const { return map_; }
+
+private:
+    // Candidates for one depth: a neighbour range of an earlier image, or
+    // with all set, every target vertex from scan on
+    struct Frame {
+        VertexRange range;
+        VERTEX_ID_T scan;
+        bool all;
+    };
+    // An earlier pattern neighbour of the vertex at some depth
+    struct BackEdge {
+        uint32_t depth;     // where the neighbour is in the matching order
+        bool out, in;       // edges vertex -> neighbour and neighbour -> vertex
+    };
+
+    void computeOrder();
+    Frame candidates(size_t depth) const;
+    VERTEX_ID_T nextCandidate(Frame& f) const;
+    bool feasible(size_t depth, VERTEX_ID_T v);
+    // Sorted (largest first) total degrees of the out- then in-neighbours
+    // of a pattern or target vertex, truncated to the pattern's maxima
+    void signature(const CsrGraph& g, VERTEX_ID_T u, uint32_t* out) const;
+    const uint32_t* targetSignature(VERTEX_ID_T v);
+
+    const CsrGraph& p_;
+    const CsrGraph& t_;
+    bool induced_;
+    bool directed_;
+    size_t k_;                                  // pattern vertices
+    std::vector<VERTEX_ID_T> order_;            // matching order of pattern vertices
+    std::vector<std::vector<BackEdge> > back_;  // per depth
+    size_t maxOut_, maxIn_;                     // pattern signature lengths
+    std::vector<uint32_t> psig_;                // per depth, maxOut_ + maxIn_ each
+    HashTable<VERTEX_ID_T, uint32_t> tsigAt_;   // target vertex -> its signature in tsig_
+    std::vector<uint32_t> tsig_;
+    mutable std::vector<uint32_t> scratch_;
+    std::vector<Frame> frames_;                 // per depth
+    std::vector<VERTEX_ID_T> image_;            // per depth; INVALID_VERTEX if unmatched
+    std::vector<VERTEX_ID_T> map_;              // per pattern vertex
+    size_t top_;
+    bool started_;
+};
+
+/**
+ * @brief Calls onMatch with each embedding of pattern in target, as
+ * SubgraphMatcher::mapping(), until onMatch returns false or the limit
+ * is reached
+ *
+ * @return the number of embeddings passed to onMatch
+ */
+size_t csrSubgraphIso(const CsrGraph& pattern, const CsrGraph& target,
+                      const std::function<bool(const std::vector<VERTEX_ID_T>&)>& onMatch,
+                      const SubgraphOptions& options = SubgraphOptions());
+
+/**
+ * @brief csrSubgraphIso() on Graphs: each embedding is passed as a map
+ * from pattern vertex names to target vertex names
+ */
+size_t subgraphIso(const Graph& pattern, const Graph& target,
+                   const std::function<bool(const VERTEX_ID_MAP_T&)>& onMatch,
+                   const SubgraphOptions& options = SubgraphOptions());
+
+#endif